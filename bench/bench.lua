@@ -0,0 +1,205 @@
+#!/usr/bin/env tarantool
+-- Microbenchmarks of the driver against the stub OCI library, no
+-- database is needed. Run with `make bench`, an optional argument
+-- selects benchmarks by name prefix. Results are rows or calls per
+-- second, heap allocations and lua garbage per row. Allocations are
+-- counted when malloc_count is preloaded.
+
+local ora = require('ora')
+local clock = require('clock')
+local ffi = require('ffi')
+
+ffi.cdef[[
+uint64_t malloc_count(void);
+]]
+
+local counted = pcall(function() return ffi.C.malloc_count end)
+
+local function allocations()
+    return counted and tonumber(ffi.C.malloc_count()) or 0
+end
+
+local filter = arg[1]
+
+local conn = ora.connect({host = 'stub', port = '0', db = 'stub',
+                          user = 'stub', pass = 'stub', raise = true})
+
+-- Run fn once to warm up and once measured, fn returns count of rows.
+local function bench(name, fn)
+    if filter ~= nil and name:sub(1, #filter) ~= filter then
+        return
+    end
+    fn()
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local mallocs = allocations()
+    local garbage = collectgarbage('count')
+    local start = clock.monotonic()
+    local rows = fn()
+    local seconds = clock.monotonic() - start
+    garbage = (collectgarbage('count') - garbage) * 1024
+    mallocs = allocations() - mallocs
+    collectgarbage('restart')
+    print(string.format('%-24s %12.0f rows/s %10s allocs/row %10.1f lua bytes/row',
+                        name, rows / seconds,
+                        counted and string.format('%.2f', mallocs / rows) or '-',
+                        garbage / rows))
+end
+
+local ROWS = 100000
+local CALLS = 10000
+
+-- Row conversion by type mix, see bench/oci_stub.c for the codes
+for _, mix in ipairs({'NNNN', 'DDDD', 'IIII', 'FFFF', 'VVVV', 'RRRR', 'NVDF'}) do
+    bench('convert/' .. mix, function()
+        local sql = string.format("select * from stub(%d, '%s')", ROWS, mix)
+        return #conn:execute(sql)
+    end)
+end
+
+-- Execute overhead without binds and results
+bench('execute', function()
+    for _ = 1, CALLS do
+        conn:execute('update stub set c1 = 1')
+    end
+    return CALLS
+end)
+
+-- Bind setup by count of parameters
+for _, count in ipairs({1, 4, 16}) do
+    local names, args = {}, {}
+    for i = 1, count do
+        names[i] = ':' .. i
+        args[i] = i % 2 == 0 and 'value ' .. i or i
+    end
+    local sql = string.format('insert into stub values (%s)', table.concat(names, ', '))
+    bench('binds/' .. count, function()
+        for _ = 1, CALLS do
+            conn:execute(sql, args)
+        end
+        return CALLS
+    end)
+end
+
+-- Prepared statement executions by count of parameters
+for _, count in ipairs({1, 4, 16}) do
+    local names, args = {}, {}
+    for i = 1, count do
+        names[i] = ':' .. i
+        args[i] = i % 2 == 0 and 'value ' .. i or i
+    end
+    local sql = string.format('insert into stub values (%s)', table.concat(names, ', '))
+    bench('prepared/' .. count, function()
+        local stmt = conn:prepare(sql)
+        for _ = 1, CALLS do
+            stmt:execute(args)
+        end
+        stmt:close()
+        return CALLS
+    end)
+end
+
+-- Dependent statements one by one and as a batch in one worker job
+local BATCH = {
+    {'insert into stub values (:1, :2)', {1, 'header'}},
+    {'insert into stub values (:1, :2)', {1, 'line'}},
+    {'update stub set c1 = c1 + 1'},
+    {'commit'},
+}
+
+bench('batch/sequential', function()
+    for _ = 1, CALLS do
+        for _, stmt in ipairs(BATCH) do
+            conn:execute(stmt[1], stmt[2])
+        end
+    end
+    return CALLS
+end)
+
+bench('batch/execute_batch', function()
+    for _ = 1, CALLS do
+        conn:execute_batch(BATCH)
+    end
+    return CALLS
+end)
+
+-- Array DML, rows per second
+bench('execute_array', function()
+    local rows = {}
+    for i = 1, 1000 do
+        rows[i] = {i, i + 0.5, 'value ' .. i}
+    end
+    local total = 0
+    for _ = 1, 100 do
+        total = total + conn:execute_array('insert into stub values (:1, :2, :3)', rows)
+    end
+    return total
+end)
+
+-- Cursor iteration
+local CURSOR_SQL = string.format("select * from stub(%d, 'NVDF')", ROWS)
+
+bench('cursor/fetch', function()
+    local count = 0
+    conn:cursor_open(CURSOR_SQL)
+    while conn:cursor_fetch() ~= nil do
+        count = count + 1
+    end
+    conn:cursor_close()
+    return count
+end)
+
+bench('cursor/rows', function()
+    local count = 0
+    for _ in conn:rows(CURSOR_SQL, nil, {batch = 100}) do
+        count = count + 1
+    end
+    return count
+end)
+
+bench('cursor/batches', function()
+    local count, sum = 0, 0
+    for batch in conn:batches(CURSOR_SQL, nil, {batch = 100}) do
+        for row = 1, batch.count do
+            sum = sum + batch:number(1, row)
+        end
+        count = count + batch.count
+    end
+    return count
+end)
+
+bench('cursor/stream', function()
+    local count = 0
+    local ch = conn:stream(CURSOR_SQL, nil, {batch = 100})
+    while true do
+        local batch = ch:get()
+        if batch == nil then
+            break
+        end
+        count = count + #batch
+    end
+    return count
+end)
+
+-- Export to a file against encoding the rows of execute in lua
+local EXPORT_PATH = os.tmpname()
+
+bench('export/lua_json', function()
+    local json = require('json')
+    local file = io.open(EXPORT_PATH, 'w')
+    local rows = conn:execute(CURSOR_SQL)
+    for _, row in ipairs(rows) do
+        file:write(json.encode(row), '\n')
+    end
+    file:close()
+    return #rows
+end)
+
+for _, format in ipairs({'csv', 'msgpack', 'jsonl'}) do
+    bench('export/' .. format, function()
+        return conn:export(CURSOR_SQL, nil, EXPORT_PATH, {format = format})
+    end)
+end
+os.remove(EXPORT_PATH)
+
+conn:close()
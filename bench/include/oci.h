@@ -0,0 +1,337 @@
+/*
+ * Subset of the OCI header declaring what the driver and the stub OCI
+ * library use, so the benchmarks build without the Oracle client SDK.
+ * Constant values are those of the real headers (oci.h, ocidfn.h,
+ * orl.h, oro.h), which keeps switch statements of the driver the same
+ * as in a build against the SDK.
+ */
+#ifndef ORA_BENCH_OCI_H
+#define ORA_BENCH_OCI_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned char ub1;
+typedef signed char sb1;
+typedef unsigned short ub2;
+typedef signed short sb2;
+typedef unsigned int ub4;
+typedef signed int sb4;
+typedef unsigned long long ub8;
+typedef signed long long sb8;
+typedef int sword;
+typedef unsigned int uword;
+typedef int boolean;
+typedef unsigned char text;
+typedef unsigned char OraText;
+typedef unsigned char oratext;
+
+#ifndef dvoid
+#define dvoid void
+#endif
+
+typedef struct OCIEnv OCIEnv;
+typedef struct OCIError OCIError;
+typedef struct OCISvcCtx OCISvcCtx;
+typedef struct OCIStmt OCIStmt;
+typedef struct OCIBind OCIBind;
+typedef struct OCIDefine OCIDefine;
+typedef struct OCIServer OCIServer;
+typedef struct OCISession OCISession;
+typedef struct OCIParam OCIParam;
+typedef struct OCISnapshot OCISnapshot;
+typedef struct OCILobLocator OCILobLocator;
+typedef struct OCILobLocator OCIClobLocator;
+typedef struct OCILobLocator OCIBlobLocator;
+typedef struct OCIDirPathCtx OCIDirPathCtx;
+typedef struct OCIDirPathColArray OCIDirPathColArray;
+typedef struct OCIDirPathStream OCIDirPathStream;
+
+#define OCI_NUMBER_SIZE 22
+typedef struct OCINumber {
+	ub1 OCINumberPart[OCI_NUMBER_SIZE];
+} OCINumber;
+
+typedef sb4 (*OCICallbackInBind)(void *ictxp, OCIBind *bindp, ub4 iter,
+				 ub4 index, void **bufpp, ub4 *alenp,
+				 ub1 *piecep, void **indp);
+typedef sb4 (*OCICallbackOutBind)(void *octxp, OCIBind *bindp, ub4 iter,
+				  ub4 index, void **bufpp, ub4 **alenp,
+				  ub1 *piecep, void **indp, ub2 **rcodep);
+typedef sb4 (*OCICallbackLobRead)(void *ctxp, const void *bufp, ub4 len,
+				  ub1 piece);
+
+/* Return codes */
+#define OCI_SUCCESS			0
+#define OCI_SUCCESS_WITH_INFO		1
+#define OCI_NEED_DATA			99
+#define OCI_NO_DATA			100
+#define OCI_ERROR			-1
+#define OCI_INVALID_HANDLE		-2
+#define OCI_STILL_EXECUTING		-3123
+#define OCI_CONTINUE			-24200
+
+/* Modes */
+#define OCI_DEFAULT			0x00000000
+#define OCI_THREADED			0x00000001
+#define OCI_DATA_AT_EXEC		0x00000002
+#define OCI_DESCRIBE_ONLY		0x00000010
+#define OCI_COMMIT_ON_SUCCESS		0x00000020
+#define OCI_BATCH_ERRORS		0x00000080
+
+#define OCI_NTV_SYNTAX			1
+#define OCI_FETCH_NEXT			0x00000002
+#define OCI_ONE_PIECE			0
+#define OCI_CRED_RDBMS			1
+#define OCI_NUMBER_UNSIGNED		0
+#define OCI_NUMBER_SIGNED		2
+#define OCI_RESULT_TYPE_SELECT		1
+
+/* Handle and descriptor types */
+#define OCI_HTYPE_ENV			1
+#define OCI_HTYPE_ERROR			2
+#define OCI_HTYPE_SVCCTX		3
+#define OCI_HTYPE_STMT			4
+#define OCI_HTYPE_BIND			5
+#define OCI_HTYPE_DEFINE		6
+#define OCI_HTYPE_SERVER		8
+#define OCI_HTYPE_SESSION		9
+#define OCI_HTYPE_DIRPATH_CTX		14
+#define OCI_HTYPE_DIRPATH_COLUMN_ARRAY	15
+#define OCI_HTYPE_DIRPATH_STREAM	16
+
+#define OCI_DTYPE_LOB			50
+#define OCI_DTYPE_PARAM			53
+
+/* Attributes */
+#define OCI_ATTR_DATA_SIZE		1
+#define OCI_ATTR_DATA_TYPE		2
+#define OCI_ATTR_NAME			4
+#define OCI_ATTR_SERVER			6
+#define OCI_ATTR_SESSION		7
+#define OCI_ATTR_ROW_COUNT		9
+#define OCI_ATTR_SCHEMA_NAME		9
+#define OCI_ATTR_PREFETCH_ROWS		11
+#define OCI_ATTR_PARAM_COUNT		18
+#define OCI_ATTR_USERNAME		22
+#define OCI_ATTR_PASSWORD		23
+#define OCI_ATTR_STMT_TYPE		24
+#define OCI_ATTR_ROWS_RETURNED		42
+#define OCI_ATTR_NUM_DML_ERRORS		73
+#define OCI_ATTR_DML_ROW_OFFSET		74
+#define OCI_ATTR_DATEFORMAT		75
+#define OCI_ATTR_BUF_SIZE		77
+#define OCI_ATTR_NUM_ROWS		81
+#define OCI_ATTR_NUM_COLS		102
+#define OCI_ATTR_LIST_COLUMNS		103
+#define OCI_ATTR_STMTCACHESIZE		176
+#define OCI_ATTR_BIND_COUNT		190
+#define OCI_ATTR_ROWS_FETCHED		197
+#define OCI_ATTR_CHAR_USED		285
+#define OCI_ATTR_CHAR_SIZE		286
+#define OCI_ATTR_IMPLICIT_RESULT_COUNT	463
+
+/* Statement types */
+#define OCI_STMT_SELECT			1
+#define OCI_STMT_UPDATE			2
+#define OCI_STMT_DELETE			3
+#define OCI_STMT_INSERT			4
+#define OCI_STMT_CREATE			5
+#define OCI_STMT_DROP			6
+#define OCI_STMT_ALTER			7
+#define OCI_STMT_BEGIN			8
+#define OCI_STMT_DECLARE		9
+#define OCI_STMT_CALL			10
+#define OCI_STMT_MERGE			16
+
+/* Direct path column flags */
+#define OCI_DIRPATH_COL_COMPLETE	0
+#define OCI_DIRPATH_COL_NULL		1
+#define OCI_DIRPATH_COL_PARTIAL		2
+#define OCI_DIRPATH_COL_ERROR		3
+
+/* External data types */
+#define SQLT_CHR			1
+#define SQLT_NUM			2
+#define SQLT_INT			3
+#define SQLT_FLT			4
+#define SQLT_STR			5
+#define SQLT_VNU			6
+#define SQLT_VCS			9
+#define SQLT_DAT			12
+#define SQLT_BFLOAT			21
+#define SQLT_BDOUBLE			22
+#define SQLT_BIN			23
+#define SQLT_LBI			24
+#define SQLT_UIN			68
+#define SQLT_LVB			94
+#define SQLT_AFC			96
+#define SQLT_AVC			97
+#define SQLT_CLOB			112
+#define SQLT_BLOB			113
+#define SQLT_RSET			116
+
+/* Type codes */
+#define OCI_TYPECODE_VARCHAR		SQLT_CHR
+#define OCI_TYPECODE_NUMBER		SQLT_NUM
+#define OCI_TYPECODE_INTEGER		SQLT_INT
+#define OCI_TYPECODE_VARCHAR2		SQLT_VCS
+#define OCI_TYPECODE_REAL		21
+#define OCI_TYPECODE_DOUBLE		22
+#define OCI_TYPECODE_UNSIGNED8		SQLT_BIN
+#define OCI_TYPECODE_UNSIGNED16		25
+#define OCI_TYPECODE_UNSIGNED32		26
+#define OCI_TYPECODE_SIGNED8		27
+#define OCI_TYPECODE_SIGNED16		28
+#define OCI_TYPECODE_SIGNED32		29
+#define OCI_TYPECODE_RAW		SQLT_LVB
+#define OCI_TYPECODE_CLOB		SQLT_CLOB
+#define OCI_TYPECODE_BLOB		SQLT_BLOB
+#define OCI_TYPECODE_OCTET		245
+#define OCI_TYPECODE_SMALLINT		246
+
+/* Handles and attributes */
+sword
+OCIEnvNlsCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+		void *(*malocfp)(void *, size_t),
+		void *(*ralocfp)(void *, void *, size_t),
+		void (*mfreefp)(void *, void *), size_t xtramem_sz,
+		void **usrmempp, ub2 charset, ub2 ncharset);
+sword
+OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type,
+	       const size_t xtramem_sz, void **usrmempp);
+sword
+OCIHandleFree(void *hndlp, const ub4 type);
+sword
+OCIDescriptorAlloc(const void *parenth, void **descpp, const ub4 type,
+		   const size_t xtramem_sz, void **usrmempp);
+sword
+OCIDescriptorFree(void *descp, const ub4 type);
+sword
+OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep,
+	   ub4 *sizep, ub4 attrtype, OCIError *errhp);
+sword
+OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *attributep, ub4 size,
+	   ub4 attrtype, OCIError *errhp);
+sword
+OCIParamGet(const void *hndlp, ub4 htype, OCIError *errhp, void **parmdpp,
+	    ub4 pos);
+sword
+OCIErrorGet(void *hndlp, ub4 recordno, OraText *sqlstate, sb4 *errcodep,
+	    OraText *bufp, ub4 bufsiz, ub4 type);
+
+/* Sessions and transactions */
+sword
+OCIServerAttach(OCIServer *srvhp, OCIError *errhp, const OraText *dblink,
+		sb4 dblink_len, ub4 mode);
+sword
+OCIServerDetach(OCIServer *srvhp, OCIError *errhp, ub4 mode);
+sword
+OCISessionBegin(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+		ub4 credt, ub4 mode);
+sword
+OCISessionEnd(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+	      ub4 mode);
+sword
+OCITransCommit(OCISvcCtx *svchp, OCIError *errhp, ub4 flags);
+sword
+OCITransRollback(OCISvcCtx *svchp, OCIError *errhp, ub4 flags);
+
+/* Statements */
+sword
+OCIStmtPrepare(OCIStmt *stmtp, OCIError *errhp, const OraText *stmt,
+	       ub4 stmt_len, ub4 language, ub4 mode);
+sword
+OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp,
+	       ub4 iters, ub4 rowoff, const OCISnapshot *snap_in,
+	       OCISnapshot *snap_out, ub4 mode);
+sword
+OCIStmtFetch(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2 orientation,
+	     ub4 mode);
+sword
+OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2 orientation,
+	      sb4 scrollOffset, ub4 mode);
+sword
+OCIStmtGetNextResult(OCIStmt *stmthp, OCIError *errhp, void **result,
+		     ub4 *rtype, ub4 mode);
+sword
+OCIStmtGetBindInfo(OCIStmt *stmtp, OCIError *errhp, ub4 size,
+		   ub4 startloc, sb4 *found, OraText *bvnp[], ub1 bvnl[],
+		   OraText *invp[], ub1 inpl[], ub1 dupl[], OCIBind **hndl);
+
+/* Binds and defines */
+sword
+OCIBindByName(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp,
+	      const OraText *placeholder, sb4 placeh_len, void *valuep,
+	      sb4 value_sz, ub2 dty, void *indp, ub2 *alenp, ub2 *rcodep,
+	      ub4 maxarr_len, ub4 *curelep, ub4 mode);
+sword
+OCIBindByPos(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp,
+	     ub4 position, void *valuep, sb4 value_sz, ub2 dty, void *indp,
+	     ub2 *alenp, ub2 *rcodep, ub4 maxarr_len, ub4 *curelep,
+	     ub4 mode);
+sword
+OCIBindDynamic(OCIBind *bindp, OCIError *errhp, void *ictxp,
+	       OCICallbackInBind icbfp, void *octxp,
+	       OCICallbackOutBind ocbfp);
+sword
+OCIBindArrayOfStruct(OCIBind *bindp, OCIError *errhp, ub4 pvskip,
+		     ub4 indskip, ub4 alskip, ub4 rcskip);
+sword
+OCIDefineByPos(OCIStmt *stmtp, OCIDefine **defnp, OCIError *errhp,
+	       ub4 position, void *valuep, sb4 value_sz, ub2 dty, void *indp,
+	       ub2 *rlenp, ub2 *rcodep, ub4 mode);
+
+/* LOBs */
+sword
+OCILobGetLength(OCISvcCtx *svchp, OCIError *errhp, OCILobLocator *locp,
+		ub4 *lenp);
+sword
+OCILobRead(OCISvcCtx *svchp, OCIError *errhp, OCILobLocator *locp,
+	   ub4 *amtp, ub4 offset, void *bufp, ub4 bufl, void *ctxp,
+	   OCICallbackLobRead cbfp, ub2 csid, ub1 csfrm);
+sword
+OCILobCharSetForm(OCIEnv *envhp, OCIError *errhp,
+		  const OCILobLocator *locp, ub1 *csfrm);
+
+/* Numbers */
+sword
+OCINumberFromInt(OCIError *err, const void *inum, uword inum_length,
+		 uword inum_s_flag, OCINumber *number);
+sword
+OCINumberToInt(OCIError *err, const OCINumber *number, uword rsl_length,
+	       uword rsl_flag, void *rsl);
+sword
+OCINumberFromReal(OCIError *err, const void *rnum, uword rnum_length,
+		  OCINumber *number);
+sword
+OCINumberToReal(OCIError *err, const OCINumber *number, uword rsl_length,
+		void *rsl);
+sword
+OCINumberIsInt(OCIError *err, const OCINumber *number, boolean *result);
+
+/* Direct path */
+sword
+OCIDirPathPrepare(OCIDirPathCtx *dpctx, OCISvcCtx *svchp, OCIError *errhp);
+sword
+OCIDirPathLoadStream(OCIDirPathCtx *dpctx, OCIDirPathStream *dpstr,
+		     OCIError *errhp);
+sword
+OCIDirPathFinish(OCIDirPathCtx *dpctx, OCIError *errhp);
+sword
+OCIDirPathAbort(OCIDirPathCtx *dpctx, OCIError *errhp);
+sword
+OCIDirPathColArrayEntrySet(OCIDirPathColArray *dpca, OCIError *errhp,
+			   ub4 rownum, ub2 colIdx, ub1 *cvalp, ub4 clen,
+			   ub1 cflg);
+sword
+OCIDirPathColArrayReset(OCIDirPathColArray *dpca, OCIError *errhp);
+sword
+OCIDirPathColArrayToStream(OCIDirPathColArray *dpca,
+			   const OCIDirPathCtx *dpctx,
+			   OCIDirPathStream *dpstr, OCIError *errhp,
+			   ub4 rowcnt, ub4 rowoff);
+sword
+OCIDirPathStreamReset(OCIDirPathStream *dpstr, OCIError *errhp);
+
+#endif /* ORA_BENCH_OCI_H */
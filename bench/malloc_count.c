@@ -0,0 +1,99 @@
+/*
+ * Preload library counting heap allocations of the process. Benchmarks
+ * read the counter through FFI to report allocations per row. Memory
+ * of the Lua heap is not allocated with malloc and is not counted.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static uint64_t count;
+
+/* dlsym could allocate before the real functions are known */
+static char early_buf[4096];
+static size_t early_used;
+static int initializing;
+
+static void
+malloc_count_init(void)
+{
+	initializing = 1;
+	real_malloc = dlsym(RTLD_NEXT, "malloc");
+	real_calloc = dlsym(RTLD_NEXT, "calloc");
+	real_realloc = dlsym(RTLD_NEXT, "realloc");
+	real_free = dlsym(RTLD_NEXT, "free");
+	initializing = 0;
+}
+
+static int
+is_early(void *ptr)
+{
+	return (char *)ptr >= early_buf &&
+	       (char *)ptr < early_buf + sizeof(early_buf);
+}
+
+uint64_t
+malloc_count(void)
+{
+	return __atomic_load_n(&count, __ATOMIC_RELAXED);
+}
+
+void *
+malloc(size_t size)
+{
+	if (real_malloc == NULL)
+		malloc_count_init();
+	__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+	return real_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	if (real_calloc == NULL) {
+		if (!initializing)
+			malloc_count_init();
+		if (initializing) {
+			size_t len = (nmemb * size + 15) & ~(size_t)15;
+			if (early_used + len > sizeof(early_buf))
+				return NULL;
+			void *ptr = early_buf + early_used;
+			early_used += len;
+			return ptr;
+		}
+	}
+	__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+	return real_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	if (real_realloc == NULL)
+		malloc_count_init();
+	__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+	if (is_early(ptr)) {
+		size_t avail = early_buf + sizeof(early_buf) - (char *)ptr;
+		void *res = real_malloc(size);
+		if (res != NULL)
+			memcpy(res, ptr, size < avail ? size : avail);
+		return res;
+	}
+	return real_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+	if (ptr == NULL || is_early(ptr))
+		return;
+	if (real_free == NULL)
+		malloc_count_init();
+	real_free(ptr);
+}
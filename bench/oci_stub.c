@@ -0,0 +1,1061 @@
+/*
+ * Stub of the OCI client library for benchmarks. It implements the
+ * entry points used by the driver and serves synthetic rows from
+ * memory, so the driver could be measured without a database.
+ *
+ * Select statements name the result set in the FROM clause:
+ *
+ *	select * from stub(100000, 'NVFD')
+ *
+ * gives 100000 rows of columns C1..C4 of the listed types:
+ *
+ *	N - integral NUMBER
+ *	D - fractional NUMBER
+ *	V - VARCHAR2(32)
+ *	F - BINARY_DOUBLE
+ *	I - INTEGER
+ *	R - RAW(16)
+ *
+ * Any other select gives one row with a NUMBER column CODE equal to 1.
+ * DML statements process one row per iteration, input callbacks of
+ * dynamic binds are called for every iteration. A statement with fewer
+ * binds than distinct placeholders fails with ORA-01008. Values of PL/SQL OUT
+ * parameters are NULL, RETURNING clauses return no rows. LOB and
+ * direct path functions fail.
+ *
+ * Numbers are not in the Oracle format: OCINumber keeps a kind byte
+ * followed by an int64 or a double, only the stub functions read them.
+ *
+ * Latency and failures are injected on the calling thread, settings are
+ * read from the environment when an environment handle is created:
+ *
+ *	ORA_STUB_LATENCY_MS	round trip time of every server call
+ *	ORA_STUB_EXEC_MS	execution time of every statement
+ *	ORA_STUB_FAIL_RATE	share of calls failing with ORA-03113, the
+ *				connection is lost after that
+ *	ORA_STUB_TIMEOUT_RATE	share of calls failing with ORA-12609 after
+ *				ORA_STUB_TIMEOUT_MS
+ *
+ * A statement could add its own execution time with stub_ms(<ms>)
+ * anywhere in its text.
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <oci.h>
+
+#define STUB_MAX_COLUMNS 64
+#define STUB_MAX_BINDS 64
+#define STUB_VARCHAR_SIZE 32
+#define STUB_RAW_SIZE 16
+
+enum stub_number_kind {
+	STUB_NUMBER_INT = 1,
+	STUB_NUMBER_REAL = 2,
+};
+
+struct OCIError {
+	ub4 htype;
+	sb4 code;
+	char message[256];
+};
+
+struct OCIParam {
+	ub4 htype;
+	ub2 type;
+	ub2 size;
+	char name[8];
+	ub4 name_len;
+	char kind;
+};
+
+struct OCIDefine {
+	ub4 htype;
+	void *value;
+	sb4 value_sz;
+	ub2 dty;
+	sb2 *ind;
+	ub2 *len;
+};
+
+struct OCIBind {
+	ub4 htype;
+	struct OCIBind *next;
+	void *ictxp;
+	OCICallbackInBind icbfp;
+	void *octxp;
+	OCICallbackOutBind ocbfp;
+};
+
+struct OCIStmt {
+	ub4 htype;
+	char *sql;
+	ub2 stmt_type;
+	/* execution time of stub_ms() */
+	double exec_ms;
+	/* service context of the last execute */
+	struct OCISvcCtx *svchp;
+	/* result set */
+	ub4 col_count;
+	uint64_t rows;
+	uint64_t pos;
+	struct OCIParam params[STUB_MAX_COLUMNS];
+	struct OCIDefine defines[STUB_MAX_COLUMNS];
+	ub4 rows_fetched;
+	ub4 row_count;
+	/* placeholders, names point into sql */
+	ub4 placeholders;
+	OraText *names[STUB_MAX_BINDS];
+	ub1 name_lens[STUB_MAX_BINDS];
+	ub1 dups[STUB_MAX_BINDS];
+	/* binds are owned by the statement */
+	struct OCIBind *binds;
+	ub4 bind_count;
+};
+
+struct OCISvcCtx {
+	ub4 htype;
+	/* ORA-03113 was injected, all later calls fail */
+	bool lost;
+};
+
+struct stub_handle {
+	ub4 htype;
+};
+
+static struct {
+	double latency_ms;
+	double exec_ms;
+	double fail_rate;
+	double timeout_rate;
+	double timeout_ms;
+} stub_cfg;
+
+static __thread unsigned int stub_seed;
+
+static sword
+stub_error(OCIError *errhp, sb4 code, const char *message)
+{
+	if (errhp != NULL) {
+		errhp->code = code;
+		snprintf(errhp->message, sizeof(errhp->message),
+			 "ORA-%05d: %s", code, message);
+	}
+	return OCI_ERROR;
+}
+
+static sword
+stub_unsupported(OCIError *errhp)
+{
+	return stub_error(errhp, 3001, "unimplemented feature in the stub");
+}
+
+static double
+stub_env(const char *name, double dflt)
+{
+	const char *value = getenv(name);
+	return value != NULL ? strtod(value, NULL) : dflt;
+}
+
+static void
+stub_sleep(double ms)
+{
+	if (ms <= 0)
+		return;
+	struct timespec ts;
+	ts.tv_sec = (time_t)(ms / 1000);
+	ts.tv_nsec = (long)((ms - ts.tv_sec * 1000.0) * 1e6);
+	while (nanosleep(&ts, &ts) != 0)
+		;
+}
+
+static double
+stub_random(void)
+{
+	if (stub_seed == 0)
+		stub_seed = (unsigned int)time(NULL) ^
+			    (unsigned int)(uintptr_t)&stub_seed;
+	return (double)rand_r(&stub_seed) / ((double)RAND_MAX + 1);
+}
+
+/*
+ * A round trip to the server: wait for the network and maybe fail.
+ * The service context is NULL for calls made before execute.
+ */
+static sword
+stub_round_trip(OCISvcCtx *svchp, OCIError *errhp, double exec_ms)
+{
+	if (svchp != NULL && svchp->lost)
+		return stub_error(errhp, 3114, "not connected to ORACLE");
+	stub_sleep(stub_cfg.latency_ms + exec_ms);
+	double dice = stub_random();
+	if (dice < stub_cfg.fail_rate) {
+		if (svchp != NULL)
+			svchp->lost = true;
+		return stub_error(errhp, 3113,
+				  "end-of-file on communication channel");
+	}
+	dice -= stub_cfg.fail_rate;
+	if (dice < stub_cfg.timeout_rate) {
+		stub_sleep(stub_cfg.timeout_ms);
+		return stub_error(errhp, 12609,
+				  "TNS: Receive timeout occurred");
+	}
+	return OCI_SUCCESS;
+}
+
+/* Environment and handles */
+
+sword
+OCIEnvNlsCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+		void *(*malocfp)(void *, size_t),
+		void *(*ralocfp)(void *, void *, size_t),
+		void (*mfreefp)(void *, void *), size_t xtramem_sz,
+		void **usrmempp, ub2 charset, ub2 ncharset)
+{
+	(void) mode; (void) ctxp; (void) malocfp; (void) ralocfp;
+	(void) mfreefp; (void) xtramem_sz; (void) usrmempp;
+	(void) charset; (void) ncharset;
+	stub_cfg.latency_ms = stub_env("ORA_STUB_LATENCY_MS", 0);
+	stub_cfg.exec_ms = stub_env("ORA_STUB_EXEC_MS", 0);
+	stub_cfg.fail_rate = stub_env("ORA_STUB_FAIL_RATE", 0);
+	stub_cfg.timeout_rate = stub_env("ORA_STUB_TIMEOUT_RATE", 0);
+	stub_cfg.timeout_ms = stub_env("ORA_STUB_TIMEOUT_MS", 1000);
+	struct stub_handle *env = calloc(1, sizeof(*env));
+	if (env == NULL)
+		return OCI_ERROR;
+	env->htype = OCI_HTYPE_ENV;
+	*envp = (OCIEnv *)env;
+	return OCI_SUCCESS;
+}
+
+static size_t
+stub_handle_size(ub4 type)
+{
+	switch (type) {
+	case OCI_HTYPE_ERROR:
+		return sizeof(struct OCIError);
+	case OCI_HTYPE_STMT:
+		return sizeof(struct OCIStmt);
+	case OCI_HTYPE_SVCCTX:
+		return sizeof(struct OCISvcCtx);
+	default:
+		return sizeof(struct stub_handle);
+	}
+}
+
+sword
+OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type,
+	       const size_t xtramem_sz, void **usrmempp)
+{
+	(void) parenth; (void) xtramem_sz; (void) usrmempp;
+	struct stub_handle *handle = calloc(1, stub_handle_size(type));
+	if (handle == NULL)
+		return OCI_ERROR;
+	handle->htype = type;
+	*hndlpp = handle;
+	return OCI_SUCCESS;
+}
+
+static void
+stub_stmt_reset(OCIStmt *stmt)
+{
+	free(stmt->sql);
+	stmt->sql = NULL;
+	while (stmt->binds != NULL) {
+		OCIBind *next = stmt->binds->next;
+		free(stmt->binds);
+		stmt->binds = next;
+	}
+	stmt->bind_count = 0;
+	stmt->placeholders = 0;
+	stmt->col_count = 0;
+	stmt->rows = stmt->pos = 0;
+	stmt->rows_fetched = stmt->row_count = 0;
+}
+
+sword
+OCIHandleFree(void *hndlp, const ub4 type)
+{
+	switch (type) {
+	case OCI_HTYPE_BIND:
+	case OCI_HTYPE_DEFINE:
+		/* owned by the statement */
+		return OCI_SUCCESS;
+	case OCI_HTYPE_STMT:
+		stub_stmt_reset((OCIStmt *)hndlp);
+		break;
+	}
+	free(hndlp);
+	return OCI_SUCCESS;
+}
+
+sword
+OCIDescriptorAlloc(const void *parenth, void **descpp, const ub4 type,
+		   const size_t xtramem_sz, void **usrmempp)
+{
+	return OCIHandleAlloc(parenth, descpp, type, xtramem_sz, usrmempp);
+}
+
+sword
+OCIDescriptorFree(void *descp, const ub4 type)
+{
+	(void) type;
+	free(descp);
+	return OCI_SUCCESS;
+}
+
+sword
+OCIErrorGet(void *hndlp, ub4 recordno, OraText *sqlstate, sb4 *errcodep,
+	    OraText *bufp, ub4 bufsiz, ub4 type)
+{
+	(void) sqlstate; (void) type;
+	OCIError *errhp = (OCIError *)hndlp;
+	if (recordno != 1 || errhp->code == 0)
+		return OCI_NO_DATA;
+	*errcodep = errhp->code;
+	snprintf((char *)bufp, bufsiz, "%s", errhp->message);
+	return OCI_SUCCESS;
+}
+
+/* Sessions */
+
+sword
+OCIServerAttach(OCIServer *srvhp, OCIError *errhp, const OraText *dblink,
+		sb4 dblink_len, ub4 mode)
+{
+	(void) srvhp; (void) errhp; (void) dblink; (void) dblink_len;
+	(void) mode;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIServerDetach(OCIServer *srvhp, OCIError *errhp, ub4 mode)
+{
+	(void) srvhp; (void) errhp; (void) mode;
+	return OCI_SUCCESS;
+}
+
+sword
+OCISessionBegin(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+		ub4 credt, ub4 mode)
+{
+	(void) usrhp; (void) credt; (void) mode;
+	return stub_round_trip(svchp, errhp, 0);
+}
+
+sword
+OCISessionEnd(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+	      ub4 mode)
+{
+	(void) svchp; (void) errhp; (void) usrhp; (void) mode;
+	return OCI_SUCCESS;
+}
+
+/* Attributes */
+
+sword
+OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *attributep, ub4 size,
+	   ub4 attrtype, OCIError *errhp)
+{
+	(void) trgthndlp; (void) trghndltyp; (void) attributep; (void) size;
+	(void) attrtype; (void) errhp;
+	return OCI_SUCCESS;
+}
+
+static sword
+stub_param_attr(const OCIParam *param, void *attributep, ub4 *sizep,
+		ub4 attrtype)
+{
+	switch (attrtype) {
+	case OCI_ATTR_DATA_TYPE:
+		*(ub2 *)attributep = param->type;
+		break;
+	case OCI_ATTR_NAME:
+		*(const char **)attributep = param->name;
+		*sizep = param->name_len;
+		break;
+	case OCI_ATTR_CHAR_USED:
+		*(ub1 *)attributep = 0;
+		break;
+	case OCI_ATTR_DATA_SIZE:
+	case OCI_ATTR_CHAR_SIZE:
+		*(ub2 *)attributep = param->size;
+		break;
+	}
+	return OCI_SUCCESS;
+}
+
+sword
+OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep,
+	   ub4 *sizep, ub4 attrtype, OCIError *errhp)
+{
+	(void) errhp;
+	if (trghndltyp == OCI_DTYPE_PARAM)
+		return stub_param_attr((const OCIParam *)trgthndlp,
+				       attributep, sizep, attrtype);
+	if (trghndltyp == OCI_HTYPE_BIND) {
+		if (attrtype == OCI_ATTR_ROWS_RETURNED)
+			*(ub4 *)attributep = 0;
+		return OCI_SUCCESS;
+	}
+	if (trghndltyp != OCI_HTYPE_STMT)
+		return OCI_SUCCESS;
+
+	const OCIStmt *stmt = (const OCIStmt *)trgthndlp;
+	switch (attrtype) {
+	case OCI_ATTR_STMT_TYPE:
+		*(ub2 *)attributep = stmt->stmt_type;
+		break;
+	case OCI_ATTR_ROWS_FETCHED:
+		*(ub4 *)attributep = stmt->rows_fetched;
+		break;
+	case OCI_ATTR_ROW_COUNT:
+		*(ub4 *)attributep = stmt->row_count;
+		break;
+	case OCI_ATTR_PARAM_COUNT:
+		*(ub4 *)attributep = stmt->col_count;
+		break;
+	case OCI_ATTR_BIND_COUNT:
+		*(ub4 *)attributep = stmt->placeholders;
+		break;
+	case OCI_ATTR_IMPLICIT_RESULT_COUNT:
+		*(ub4 *)attributep = 0;
+		break;
+	}
+	return OCI_SUCCESS;
+}
+
+/* Statements */
+
+static bool
+stub_keyword(const char *sql, const char *keyword)
+{
+	size_t len = strlen(keyword);
+	return strncasecmp(sql, keyword, len) == 0 &&
+	       !isalnum((unsigned char)sql[len]);
+}
+
+static ub2
+stub_stmt_type(const char *sql)
+{
+	while (isspace((unsigned char)*sql) || *sql == '(')
+		++sql;
+	if (stub_keyword(sql, "select") || stub_keyword(sql, "with"))
+		return OCI_STMT_SELECT;
+	if (stub_keyword(sql, "update"))
+		return OCI_STMT_UPDATE;
+	if (stub_keyword(sql, "delete"))
+		return OCI_STMT_DELETE;
+	if (stub_keyword(sql, "insert"))
+		return OCI_STMT_INSERT;
+	if (stub_keyword(sql, "merge"))
+		return OCI_STMT_MERGE;
+	if (stub_keyword(sql, "begin"))
+		return OCI_STMT_BEGIN;
+	if (stub_keyword(sql, "declare"))
+		return OCI_STMT_DECLARE;
+	if (stub_keyword(sql, "call"))
+		return OCI_STMT_CALL;
+	if (stub_keyword(sql, "create"))
+		return OCI_STMT_CREATE;
+	if (stub_keyword(sql, "drop"))
+		return OCI_STMT_DROP;
+	return OCI_STMT_ALTER;
+}
+
+static void
+stub_add_column(OCIStmt *stmt, char kind)
+{
+	struct OCIParam *param = stmt->params + stmt->col_count;
+	param->htype = OCI_DTYPE_PARAM;
+	param->kind = kind;
+	switch (kind) {
+	case 'N':
+	case 'D':
+		param->type = SQLT_NUM;
+		param->size = 22;
+		break;
+	case 'V':
+		param->type = SQLT_VCS;
+		param->size = STUB_VARCHAR_SIZE;
+		break;
+	case 'F':
+		param->type = OCI_TYPECODE_DOUBLE;
+		param->size = sizeof(double);
+		break;
+	case 'I':
+		param->type = OCI_TYPECODE_INTEGER;
+		param->size = sizeof(int64_t);
+		break;
+	case 'R':
+		param->type = SQLT_BIN;
+		param->size = STUB_RAW_SIZE;
+		break;
+	default:
+		return;
+	}
+	++stmt->col_count;
+	param->name_len = snprintf(param->name, sizeof(param->name), "C%u",
+				   stmt->col_count);
+}
+
+/* Parse "stub(<rows>, '<types>')" of a select statement */
+static void
+stub_describe(OCIStmt *stmt)
+{
+	const char *spec = strstr(stmt->sql, "stub(");
+	if (spec == NULL) {
+		stmt->rows = 1;
+		stub_add_column(stmt, 'N');
+		strcpy(stmt->params[0].name, "CODE");
+		stmt->params[0].name_len = 4;
+		return;
+	}
+	char *end;
+	stmt->rows = strtoull(spec + strlen("stub("), &end, 10);
+	const char *types = strchr(end, '\'');
+	if (types == NULL)
+		return;
+	for (++types; *types != '\0' && *types != '\'' &&
+	     stmt->col_count < STUB_MAX_COLUMNS; ++types)
+		stub_add_column(stmt, *types);
+}
+
+/* Find :name placeholders outside of string literals */
+static void
+stub_placeholders(OCIStmt *stmt)
+{
+	bool quoted = false;
+	for (char *pos = stmt->sql; *pos != '\0'; ++pos) {
+		if (*pos == '\'')
+			quoted = !quoted;
+		if (quoted || *pos != ':' ||
+		    !(isalnum((unsigned char)pos[1]) || pos[1] == '_'))
+			continue;
+		char *name = ++pos;
+		while (isalnum((unsigned char)pos[1]) || pos[1] == '_')
+			++pos;
+		if (stmt->placeholders == STUB_MAX_BINDS)
+			return;
+		ub4 idx = stmt->placeholders++;
+		stmt->names[idx] = (OraText *)name;
+		stmt->name_lens[idx] = (ub1)(pos - name + 1);
+		stmt->dups[idx] = 0;
+		for (ub4 prev = 0; prev < idx; ++prev) {
+			if (stmt->name_lens[prev] == stmt->name_lens[idx] &&
+			    strncasecmp((char *)stmt->names[prev], name,
+					stmt->name_lens[idx]) == 0)
+				stmt->dups[idx] = 1;
+		}
+	}
+}
+
+sword
+OCIStmtPrepare(OCIStmt *stmtp, OCIError *errhp, const OraText *stmt,
+	       ub4 stmt_len, ub4 language, ub4 mode)
+{
+	(void) language; (void) mode;
+	stub_stmt_reset(stmtp);
+	stmtp->sql = strndup((const char *)stmt, stmt_len);
+	if (stmtp->sql == NULL)
+		return stub_error(errhp, 4030, "out of memory");
+	stmtp->stmt_type = stub_stmt_type(stmtp->sql);
+	const char *ms = strstr(stmtp->sql, "stub_ms(");
+	stmtp->exec_ms = ms != NULL ? strtod(ms + strlen("stub_ms("), NULL) : 0;
+	stub_placeholders(stmtp);
+	return OCI_SUCCESS;
+}
+
+sword
+OCIStmtGetBindInfo(OCIStmt *stmtp, OCIError *errhp, ub4 size, ub4 startloc,
+		   sb4 *found, OraText *bvnp[], ub1 bvnl[], OraText *invp[],
+		   ub1 inpl[], ub1 dupl[], OCIBind **hndl)
+{
+	(void) errhp;
+	if (stmtp->placeholders == 0)
+		return OCI_NO_DATA;
+	*found = stmtp->placeholders - startloc + 1 > size ?
+		 -(sb4)stmtp->placeholders : (sb4)stmtp->placeholders;
+	for (ub4 idx = 0; idx < size &&
+	     startloc - 1 + idx < stmtp->placeholders; ++idx) {
+		ub4 pos = startloc - 1 + idx;
+		bvnp[idx] = stmtp->names[pos];
+		bvnl[idx] = stmtp->name_lens[pos];
+		invp[idx] = NULL;
+		inpl[idx] = 0;
+		dupl[idx] = stmtp->dups[pos];
+		hndl[idx] = NULL;
+	}
+	return OCI_SUCCESS;
+}
+
+static sword
+stub_bind(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp)
+{
+	OCIBind *bind = calloc(1, sizeof(*bind));
+	if (bind == NULL)
+		return stub_error(errhp, 4030, "out of memory");
+	bind->htype = OCI_HTYPE_BIND;
+	bind->next = stmtp->binds;
+	stmtp->binds = bind;
+	++stmtp->bind_count;
+	*bindp = bind;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIBindByName(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp,
+	      const OraText *placeholder, sb4 placeh_len, void *valuep,
+	      sb4 value_sz, ub2 dty, void *indp, ub2 *alenp, ub2 *rcodep,
+	      ub4 maxarr_len, ub4 *curelep, ub4 mode)
+{
+	(void) placeholder; (void) placeh_len; (void) valuep; (void) value_sz;
+	(void) dty; (void) indp; (void) alenp; (void) rcodep;
+	(void) maxarr_len; (void) curelep; (void) mode;
+	return stub_bind(stmtp, bindp, errhp);
+}
+
+sword
+OCIBindByPos(OCIStmt *stmtp, OCIBind **bindp, OCIError *errhp,
+	     ub4 position, void *valuep, sb4 value_sz, ub2 dty, void *indp,
+	     ub2 *alenp, ub2 *rcodep, ub4 maxarr_len, ub4 *curelep, ub4 mode)
+{
+	(void) position; (void) valuep; (void) value_sz; (void) dty;
+	(void) indp; (void) alenp; (void) rcodep; (void) maxarr_len;
+	(void) curelep; (void) mode;
+	return stub_bind(stmtp, bindp, errhp);
+}
+
+sword
+OCIBindDynamic(OCIBind *bindp, OCIError *errhp, void *ictxp,
+	       OCICallbackInBind icbfp, void *octxp,
+	       OCICallbackOutBind ocbfp)
+{
+	(void) errhp;
+	bindp->ictxp = ictxp;
+	bindp->icbfp = icbfp;
+	bindp->octxp = octxp;
+	bindp->ocbfp = ocbfp;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIBindArrayOfStruct(OCIBind *bindp, OCIError *errhp, ub4 pvskip,
+		     ub4 indskip, ub4 alskip, ub4 rcskip)
+{
+	(void) bindp; (void) errhp; (void) pvskip; (void) indskip;
+	(void) alskip; (void) rcskip;
+	return OCI_SUCCESS;
+}
+
+/* Pass values of dynamic binds through their callbacks */
+static sword
+stub_exec_binds(OCIStmt *stmt, OCIError *errhp, ub4 iters)
+{
+	bool plsql = stmt->stmt_type == OCI_STMT_BEGIN ||
+		     stmt->stmt_type == OCI_STMT_DECLARE ||
+		     stmt->stmt_type == OCI_STMT_CALL;
+	ub4 names = 0;
+	for (ub4 idx = 0; idx < stmt->placeholders; ++idx)
+		names += !stmt->dups[idx];
+	if (stmt->bind_count < names)
+		return stub_error(errhp, 1008, "not all variables bound");
+	for (OCIBind *bind = stmt->binds; bind != NULL; bind = bind->next) {
+		for (ub4 iter = 0; iter < iters; ++iter) {
+			void *buf, *ind;
+			ub4 alen;
+			ub1 piece;
+			if (bind->icbfp != NULL &&
+			    bind->icbfp(bind->ictxp, bind, iter, 0, &buf,
+					&alen, &piece, &ind) != OCI_CONTINUE)
+				return stub_error(errhp, 1008,
+						  "not all variables bound");
+			if (!plsql || bind->ocbfp == NULL)
+				continue;
+			ub4 *alenp;
+			ub2 *rcodep;
+			if (bind->ocbfp(bind->octxp, bind, iter, 0, &buf,
+					&alenp, &piece, &ind,
+					&rcodep) != OCI_CONTINUE)
+				return stub_error(errhp, 1008,
+						  "not all variables bound");
+			*(sb2 *)ind = -1;
+			*alenp = 0;
+		}
+	}
+	return OCI_SUCCESS;
+}
+
+sword
+OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp,
+	       ub4 iters, ub4 rowoff, const OCISnapshot *snap_in,
+	       OCISnapshot *snap_out, ub4 mode)
+{
+	(void) rowoff; (void) snap_in; (void) snap_out; (void) mode;
+	stmtp->svchp = svchp;
+	sword rc = stub_round_trip(svchp, errhp,
+				   stub_cfg.exec_ms + stmtp->exec_ms);
+	if (rc != OCI_SUCCESS)
+		return rc;
+	rc = stub_exec_binds(stmtp, errhp, iters > 0 ? iters : 1);
+	if (rc != OCI_SUCCESS)
+		return rc;
+	if (stmtp->stmt_type == OCI_STMT_SELECT) {
+		stmtp->col_count = 0;
+		stmtp->pos = 0;
+		stmtp->row_count = 0;
+		stub_describe(stmtp);
+		return OCI_SUCCESS;
+	}
+	stmtp->row_count = iters;
+	return OCI_SUCCESS;
+}
+
+sword
+OCITransCommit(OCISvcCtx *svchp, OCIError *errhp, ub4 flags)
+{
+	(void) flags;
+	return stub_round_trip(svchp, errhp, 0);
+}
+
+sword
+OCITransRollback(OCISvcCtx *svchp, OCIError *errhp, ub4 flags)
+{
+	(void) flags;
+	return stub_round_trip(svchp, errhp, 0);
+}
+
+/* Implicit results are not served, ref cursor binds stay unopened */
+sword
+OCIStmtGetNextResult(OCIStmt *stmthp, OCIError *errhp, void **result,
+		     ub4 *rtype, ub4 mode)
+{
+	(void) stmthp; (void) errhp; (void) mode;
+	*result = NULL;
+	*rtype = 0;
+	return OCI_NO_DATA;
+}
+
+sword
+OCIParamGet(const void *hndlp, ub4 htype, OCIError *errhp, void **parmdpp,
+	    ub4 pos)
+{
+	(void) htype;
+	OCIStmt *stmt = (OCIStmt *)hndlp;
+	if (pos < 1 || pos > stmt->col_count)
+		return stub_error(errhp, 24334,
+				  "no descriptor for this position");
+	*parmdpp = stmt->params + pos - 1;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIDefineByPos(OCIStmt *stmtp, OCIDefine **defnp, OCIError *errhp,
+	       ub4 position, void *valuep, sb4 value_sz, ub2 dty, void *indp,
+	       ub2 *rlenp, ub2 *rcodep, ub4 mode)
+{
+	(void) rcodep; (void) mode;
+	if (position < 1 || position > stmtp->col_count)
+		return stub_error(errhp, 1007, "variable not in select list");
+	if (dty == SQLT_BLOB || dty == SQLT_CLOB)
+		return stub_unsupported(errhp);
+	OCIDefine *define = stmtp->defines + position - 1;
+	define->htype = OCI_HTYPE_DEFINE;
+	define->value = valuep;
+	define->value_sz = value_sz;
+	define->dty = dty;
+	define->ind = (sb2 *)indp;
+	define->len = rlenp;
+	*defnp = define;
+	return OCI_SUCCESS;
+}
+
+static void
+stub_number(OCINumber *number, enum stub_number_kind kind, const void *value)
+{
+	memset(number, 0, sizeof(*number));
+	number->OCINumberPart[0] = kind;
+	memcpy(number->OCINumberPart + 1, value, 8);
+}
+
+/* Write a value of the result set into a define buffer */
+static void
+stub_fetch_value(const OCIParam *param, OCIDefine *define, uint64_t row,
+		 ub4 index)
+{
+	char *dst = (char *)define->value + (size_t)define->value_sz * index;
+	char text[64];
+	int64_t inum = (int64_t)row + 1;
+	double rnum = (double)row + 0.5;
+	size_t len;
+
+	define->ind[index] = 0;
+	switch (param->kind) {
+	case 'N':
+	case 'I':
+		if (define->dty == SQLT_VNU) {
+			stub_number((OCINumber *)dst, STUB_NUMBER_INT, &inum);
+			define->len[index] = sizeof(OCINumber);
+			return;
+		}
+		if (define->dty == SQLT_INT || define->dty == SQLT_UIN) {
+			memcpy(dst, &inum, sizeof(inum));
+			define->len[index] = sizeof(inum);
+			return;
+		}
+		if (define->dty == SQLT_FLT) {
+			rnum = (double)inum;
+			memcpy(dst, &rnum, sizeof(rnum));
+			define->len[index] = sizeof(rnum);
+			return;
+		}
+		len = snprintf(text, sizeof(text), "%lld", (long long)inum);
+		break;
+	case 'D':
+	case 'F':
+		if (define->dty == SQLT_VNU) {
+			stub_number((OCINumber *)dst, STUB_NUMBER_REAL, &rnum);
+			define->len[index] = sizeof(OCINumber);
+			return;
+		}
+		if (define->dty == SQLT_FLT) {
+			memcpy(dst, &rnum, sizeof(rnum));
+			define->len[index] = sizeof(rnum);
+			return;
+		}
+		len = snprintf(text, sizeof(text), "%.1f", rnum);
+		break;
+	case 'V':
+		len = snprintf(text, sizeof(text), "value %llu",
+			       (unsigned long long)row);
+		break;
+	case 'R':
+		for (len = 0; len < STUB_RAW_SIZE; ++len)
+			text[len] = (char)(row >> (len % 8));
+		break;
+	default:
+		define->ind[index] = -1;
+		define->len[index] = 0;
+		return;
+	}
+	if (len > (size_t)define->value_sz)
+		len = define->value_sz;
+	memcpy(dst, text, len);
+	define->len[index] = (ub2)len;
+}
+
+sword
+OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2 orientation,
+	      sb4 scrollOffset, ub4 mode)
+{
+	(void) orientation; (void) scrollOffset; (void) mode;
+	sword rc = stub_round_trip(stmtp->svchp, errhp, 0);
+	if (rc != OCI_SUCCESS)
+		return rc;
+	ub4 count = 0;
+	for (; count < nrows && stmtp->pos < stmtp->rows; ++count) {
+		for (ub4 col = 0; col < stmtp->col_count; ++col) {
+			OCIDefine *define = stmtp->defines + col;
+			if (define->value == NULL)
+				continue;
+			stub_fetch_value(stmtp->params + col, define,
+					 stmtp->pos, count);
+		}
+		++stmtp->pos;
+	}
+	stmtp->rows_fetched = count;
+	stmtp->row_count += count;
+	return count < nrows ? OCI_NO_DATA : OCI_SUCCESS;
+}
+
+sword
+OCIStmtFetch(OCIStmt *stmtp, OCIError *errhp, ub4 nrows, ub2 orientation,
+	     ub4 mode)
+{
+	return OCIStmtFetch2(stmtp, errhp, nrows, orientation, 0, mode);
+}
+
+/* Numbers */
+
+sword
+OCINumberFromInt(OCIError *err, const void *inum, uword inum_length,
+		 uword inum_s_flag, OCINumber *number)
+{
+	(void) err;
+	int64_t value = 0;
+	bool is_signed = inum_s_flag == OCI_NUMBER_SIGNED;
+	switch (inum_length) {
+	case 1:
+		value = is_signed ? (int64_t)*(const int8_t *)inum :
+				    (int64_t)*(const uint8_t *)inum;
+		break;
+	case 2:
+		value = is_signed ? (int64_t)*(const int16_t *)inum :
+				    (int64_t)*(const uint16_t *)inum;
+		break;
+	case 4:
+		value = is_signed ? (int64_t)*(const int32_t *)inum :
+				    (int64_t)*(const uint32_t *)inum;
+		break;
+	default:
+		value = *(const int64_t *)inum;
+		break;
+	}
+	stub_number(number, STUB_NUMBER_INT, &value);
+	return OCI_SUCCESS;
+}
+
+sword
+OCINumberFromReal(OCIError *err, const void *rnum, uword rnum_length,
+		  OCINumber *number)
+{
+	(void) err;
+	double value = rnum_length == sizeof(float) ?
+		       *(const float *)rnum : *(const double *)rnum;
+	stub_number(number, STUB_NUMBER_REAL, &value);
+	return OCI_SUCCESS;
+}
+
+sword
+OCINumberIsInt(OCIError *err, const OCINumber *number, boolean *result)
+{
+	(void) err;
+	*result = number->OCINumberPart[0] == STUB_NUMBER_INT;
+	return OCI_SUCCESS;
+}
+
+sword
+OCINumberToInt(OCIError *err, const OCINumber *number, uword rsl_length,
+	       uword rsl_flag, void *rsl)
+{
+	(void) err; (void) rsl_flag;
+	int64_t value;
+	if (number->OCINumberPart[0] == STUB_NUMBER_INT) {
+		memcpy(&value, number->OCINumberPart + 1, sizeof(value));
+	} else {
+		double real;
+		memcpy(&real, number->OCINumberPart + 1, sizeof(real));
+		value = (int64_t)real;
+	}
+	memcpy(rsl, &value, rsl_length < sizeof(value) ? rsl_length :
+							  sizeof(value));
+	return OCI_SUCCESS;
+}
+
+sword
+OCINumberToReal(OCIError *err, const OCINumber *number, uword rsl_length,
+		void *rsl)
+{
+	(void) err;
+	double value;
+	if (number->OCINumberPart[0] == STUB_NUMBER_INT) {
+		int64_t inum;
+		memcpy(&inum, number->OCINumberPart + 1, sizeof(inum));
+		value = (double)inum;
+	} else {
+		memcpy(&value, number->OCINumberPart + 1, sizeof(value));
+	}
+	if (rsl_length == sizeof(float))
+		*(float *)rsl = (float)value;
+	else
+		*(double *)rsl = value;
+	return OCI_SUCCESS;
+}
+
+/* Not supported by the stub */
+
+sword
+OCILobGetLength(OCISvcCtx *svchp, OCIError *errhp, OCILobLocator *locp,
+		ub4 *lenp)
+{
+	(void) svchp; (void) locp; (void) lenp;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCILobRead(OCISvcCtx *svchp, OCIError *errhp, OCILobLocator *locp,
+	   ub4 *amtp, ub4 offset, void *bufp, ub4 bufl, void *ctxp,
+	   OCICallbackLobRead cbfp, ub2 csid, ub1 csfrm)
+{
+	(void) svchp; (void) locp; (void) amtp; (void) offset; (void) bufp;
+	(void) bufl; (void) ctxp; (void) cbfp; (void) csid; (void) csfrm;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCILobCharSetForm(OCIEnv *envhp, OCIError *errhp, const OCILobLocator *locp,
+		  ub1 *csfrm)
+{
+	(void) envhp; (void) locp; (void) csfrm;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathPrepare(OCIDirPathCtx *dpctx, OCISvcCtx *svchp, OCIError *errhp)
+{
+	(void) dpctx; (void) svchp;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathLoadStream(OCIDirPathCtx *dpctx, OCIDirPathStream *dpstr,
+		     OCIError *errhp)
+{
+	(void) dpctx; (void) dpstr;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathFinish(OCIDirPathCtx *dpctx, OCIError *errhp)
+{
+	(void) dpctx;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathAbort(OCIDirPathCtx *dpctx, OCIError *errhp)
+{
+	(void) dpctx; (void) errhp;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIDirPathColArrayEntrySet(OCIDirPathColArray *dpca, OCIError *errhp,
+			   ub4 rownum, ub2 colIdx, ub1 *cvalp, ub4 clen,
+			   ub1 cflg)
+{
+	(void) dpca; (void) rownum; (void) colIdx; (void) cvalp; (void) clen;
+	(void) cflg;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathColArrayReset(OCIDirPathColArray *dpca, OCIError *errhp)
+{
+	(void) dpca; (void) errhp;
+	return OCI_SUCCESS;
+}
+
+sword
+OCIDirPathColArrayToStream(OCIDirPathColArray *dpca,
+			   const OCIDirPathCtx *dpctx,
+			   OCIDirPathStream *dpstr, OCIError *errhp,
+			   ub4 rowcnt, ub4 rowoff)
+{
+	(void) dpca; (void) dpctx; (void) dpstr; (void) rowcnt; (void) rowoff;
+	return stub_unsupported(errhp);
+}
+
+sword
+OCIDirPathStreamReset(OCIDirPathStream *dpstr, OCIError *errhp)
+{
+	(void) dpstr; (void) errhp;
+	return OCI_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env tarantool
+-- Load generator for connection pools. Worker fibers run a statement
+-- through pool:get()/pool:put() for a while, for every combination of
+-- pool size and worker count. Reports throughput, p50/p99 latency and
+-- errors. Run with `make pool_load` against the stub OCI library, see
+-- bench/oci_stub.c for latency and failure injection, or against a
+-- real database with DBSERVER and DBPORT set.
+--
+-- Options are passed as name=value arguments:
+--   sizes=1,4,16     pool sizes
+--   workers=1,16,64  worker fibers
+--   duration=2       seconds per run
+--   sql=...          statement to run
+
+local ora = require('ora')
+local clock = require('clock')
+local fiber = require('fiber')
+
+local opts = {
+    sizes = '1,4,16',
+    workers = '1,16,64',
+    duration = '2',
+    sql = "select * from stub(10, 'NV')",
+}
+for _, a in ipairs(arg) do
+    local name, value = a:match('^(%w+)=(.*)$')
+    if name ~= nil then
+        opts[name] = value
+    end
+end
+
+local function numbers(list)
+    local res = {}
+    for n in list:gmatch('%d+') do
+        res[#res + 1] = tonumber(n)
+    end
+    return res
+end
+
+local function percentile(sorted, p)
+    if #sorted == 0 then
+        return 0
+    end
+    return sorted[math.max(1, math.ceil(#sorted * p))]
+end
+
+local env = os.getenv
+local pool_opts = {
+    host = env('DBSERVER') or 'stub',
+    port = env('DBPORT') or '0',
+    db = env('DBNAME') or 'stub',
+    user = env('DBUSER') or 'stub',
+    pass = env('DBPASS') or 'stub',
+    raise = true,
+}
+
+local function run(size, workers, duration)
+    pool_opts.size = size
+    local pool = ora.pool_create(pool_opts)
+    local latencies, errors = {}, {}
+    local deadline = clock.monotonic() + duration
+    local done = fiber.channel(workers)
+
+    for _ = 1, workers do
+        fiber.create(function()
+            while clock.monotonic() < deadline do
+                local start = clock.monotonic()
+                local ok, err = pcall(function()
+                    local conn = pool:get()
+                    local ok, err = pcall(conn.execute, conn, opts.sql)
+                    pool:put(conn)
+                    if not ok then
+                        error(err, 0)
+                    end
+                end)
+                if ok then
+                    latencies[#latencies + 1] = clock.monotonic() - start
+                else
+                    local code = tostring(err):match('ORA%-%d+') or tostring(err)
+                    errors[code] = (errors[code] or 0) + 1
+                end
+            end
+            done:put(true)
+        end)
+    end
+    for _ = 1, workers do
+        done:get()
+    end
+
+    local stat = pool:stat()
+    pool:close()
+    table.sort(latencies)
+    local failed = {}
+    for code, count in pairs(errors) do
+        failed[#failed + 1] = string.format('%s x%d', code, count)
+    end
+    print(string.format('%5d %8d %10.0f %9.2f %9.2f %9.2f %10.3f  %s',
+                        size, workers, #latencies / duration,
+                        percentile(latencies, 0.5) * 1000,
+                        percentile(latencies, 0.99) * 1000,
+                        percentile(latencies, 1) * 1000,
+                        stat.wait_time / math.max(1, stat.checkouts) * 1000,
+                        table.concat(failed, ', ')))
+end
+
+print(string.format('%5s %8s %10s %9s %9s %9s %10s  %s', 'size', 'workers',
+                    'req/s', 'p50 ms', 'p99 ms', 'max ms', 'wait ms', 'errors'))
+for _, size in ipairs(numbers(opts.sizes)) do
+    for _, workers in ipairs(numbers(opts.workers)) do
+        run(size, workers, tonumber(opts.duration))
+    end
+end
+os.exit(0)
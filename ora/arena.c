@@ -0,0 +1,153 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ORA_ARENA_ALIGN 16
+
+static inline size_t
+ora_arena_header(void)
+{
+	return (sizeof(struct ora_arena_block) + ORA_ARENA_ALIGN - 1) &
+	       ~(size_t)(ORA_ARENA_ALIGN - 1);
+}
+
+static inline char *
+ora_arena_data(struct ora_arena_block *block)
+{
+	return (char *)block + ora_arena_header();
+}
+
+static struct ora_arena_block *
+ora_arena_block_new(size_t size)
+{
+	struct ora_arena_block *block =
+		(struct ora_arena_block *)malloc(ora_arena_header() + size);
+	if (block == NULL)
+		return NULL;
+	block->prev = NULL;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+void *
+ora_arena_alloc(struct ora_arena *arena, size_t size)
+{
+	struct ora_arena_block *block = arena->block;
+	if (block != NULL) {
+		size_t start = (block->used + ORA_ARENA_ALIGN - 1) &
+			       ~(size_t)(ORA_ARENA_ALIGN - 1);
+		if (start <= block->size && size <= block->size - start) {
+			block->used = start + size;
+			arena->used = block->base + block->used;
+			if (arena->used > arena->peak)
+				arena->peak = arena->used;
+			return ora_arena_data(block) + start;
+		}
+	}
+
+	struct ora_arena_block *next = NULL;
+	if (arena->spare != NULL && arena->spare->size >= size) {
+		next = arena->spare;
+		arena->spare = NULL;
+	} else {
+		size_t block_size = block != NULL ? block->size * 2 :
+				    ORA_ARENA_BLOCK;
+		if (block_size < size)
+			block_size = size;
+		next = ora_arena_block_new(block_size);
+		if (next == NULL)
+			return NULL;
+	}
+	next->prev = block;
+	next->base = arena->used;
+	next->used = size;
+	arena->block = next;
+	arena->used = next->base + size;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+	return ora_arena_data(next);
+}
+
+/**
+ * Release memory allocated after the mark. The last released block is
+ * kept as a spare if it is not larger than the cap.
+ */
+void
+ora_arena_truncate(struct ora_arena *arena, size_t mark)
+{
+	if (mark > arena->used)
+		return;
+	struct ora_arena_block *block = arena->block;
+	while (block != NULL && block->prev != NULL && block->base >= mark) {
+		struct ora_arena_block *prev = block->prev;
+		if (arena->spare == NULL && block->size <= ORA_ARENA_CAP) {
+			arena->spare = block;
+		} else if (arena->spare != NULL &&
+			   arena->spare->size < block->size &&
+			   block->size <= ORA_ARENA_CAP) {
+			free(arena->spare);
+			arena->spare = block;
+		} else {
+			free(block);
+		}
+		block = prev;
+	}
+	arena->block = block;
+	if (block != NULL)
+		block->used = mark > block->base ? mark - block->base : 0;
+	arena->used = mark;
+	if (mark > 0)
+		return;
+
+	/*
+	 * The arena is empty: keep a single block for the peak usage
+	 * of the statements since the last reset, up to the cap.
+	 */
+	size_t size = arena->peak < ORA_ARENA_CAP ? arena->peak : ORA_ARENA_CAP;
+	arena->peak = 0;
+	if (block != NULL && block->size >= size && block->size <= ORA_ARENA_CAP)
+		return;
+	if (arena->spare != NULL && arena->spare->size >= size) {
+		free(block);
+		arena->block = arena->spare;
+		arena->block->prev = NULL;
+		arena->block->base = 0;
+		arena->block->used = 0;
+		arena->spare = NULL;
+		return;
+	}
+	free(block);
+	free(arena->spare);
+	arena->spare = NULL;
+	arena->block = size > 0 ? ora_arena_block_new(size) : NULL;
+	if (arena->block != NULL)
+		arena->block->base = 0;
+}
+
+size_t
+ora_arena_capacity(const struct ora_arena *arena)
+{
+	size_t size = arena->spare != NULL ? arena->spare->size : 0;
+	for (struct ora_arena_block *block = arena->block; block != NULL;
+	     block = block->prev)
+		size += block->size;
+	return size;
+}
+
+void
+ora_arena_destroy(struct ora_arena *arena)
+{
+	struct ora_arena_block *block = arena->block;
+	while (block != NULL) {
+		struct ora_arena_block *prev = block->prev;
+		free(block);
+		block = prev;
+	}
+	free(arena->spare);
+	arena->block = NULL;
+	arena->spare = NULL;
+	arena->used = 0;
+	arena->peak = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef ORA_ARENA_H
+#define ORA_ARENA_H
+
+#include <stddef.h>
+
+/* size of the first block of an arena */
+#define ORA_ARENA_BLOCK (16 * 1024)
+/* capacity kept by an arena between statements */
+#define ORA_ARENA_CAP (4 * 1024 * 1024)
+
+struct ora_arena_block {
+	struct ora_arena_block *prev;
+	/* arena offset of the first byte of the block */
+	size_t base;
+	size_t size;
+	size_t used;
+};
+
+/**
+ * Bump allocator of a connection for buffers living as long as a
+ * statement. Memory is released in LIFO order by truncating the arena
+ * to a mark taken before allocation. Blocks are chained, so allocated
+ * memory never moves. When the arena is emptied its blocks are merged
+ * into one of the peak size, up to ORA_ARENA_CAP, so the next
+ * statement of the same shape makes no malloc calls.
+ */
+struct ora_arena {
+	struct ora_arena_block *block;
+	/* a block freed by truncate, reused by the next growth */
+	struct ora_arena_block *spare;
+	/* offset of the next allocation */
+	size_t used;
+	/* the largest offset since the arena was emptied */
+	size_t peak;
+};
+
+void *
+ora_arena_alloc(struct ora_arena *arena, size_t size);
+
+static inline size_t
+ora_arena_used(const struct ora_arena *arena)
+{
+	return arena->used;
+}
+
+void
+ora_arena_truncate(struct ora_arena *arena, size_t mark);
+
+size_t
+ora_arena_capacity(const struct ora_arena *arena);
+
+void
+ora_arena_destroy(struct ora_arena *arena);
+
+#endif
@@ -6,6 +6,50 @@
 
 #include <oci.h>
 
+#include "types.h"
+#include "util.h"
+
+/**
+ * Points in time of a job passed to the coio thread pool: submitted by
+ * TX thread, started and finished by a worker thread.
+ */
+struct ora_coio_timing {
+	double submitted;
+	double started;
+	double finished;
+};
+
+static inline void
+ora_coio_timing_start(struct ora_coio_timing *timing)
+{
+	timing->submitted = clock_monotonic();
+	timing->started = timing->submitted;
+	timing->finished = timing->submitted;
+}
+
+/**
+ * Run a coio callback taking the rest of arguments and note when it
+ * has started and finished.
+ */
+static inline ssize_t
+ora_timed_cb(va_list ap)
+{
+	struct ora_coio_timing *timing = va_arg(ap, struct ora_coio_timing *);
+	coio_call_cb func = va_arg(ap, coio_call_cb);
+	timing->started = clock_monotonic();
+	ssize_t rc = func(ap);
+	timing->finished = clock_monotonic();
+	return rc;
+}
+
+static inline void
+ora_stat_coio(struct ora_stat *stat, struct ora_coio_timing *timing)
+{
+	++stat->coio_calls;
+	stat->coio_wait_time += timing->started - timing->submitted;
+	stat->oci_time += timing->finished - timing->started;
+}
+
 static inline ssize_t
 oci_stmt_execute_cb(va_list ap)
 {
@@ -14,17 +58,132 @@ oci_stmt_execute_cb(va_list ap)
 	OCIStmt *stmthp = va_arg(ap, OCIStmt *);
 	OCIError *errhp = va_arg(ap, OCIError *);
 	ub4 exec_count = va_arg(ap, ub4);
+	ub4 mode = va_arg(ap, ub4);
 	*res = OCIStmtExecute(svchp, stmthp, errhp, exec_count, 0, NULL, NULL,
-			      OCI_DEFAULT);
+			      mode);
+	return 0;
+}
+
+/**
+ * Execute a statement, mode is OCI_DEFAULT or OCI_COMMIT_ON_SUCCESS to
+ * commit the transaction in the same round trip.
+ */
+static inline sword
+oci_stmt_execute_coio(struct ora_stat *stat, OCISvcCtx *svchp, OCIStmt *stmthp,
+		      OCIError *errhp, ub4 exec_count, ub4 mode)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_stmt_execute_cb, &res,
+		  svchp, stmthp, errhp, exec_count, mode);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+static inline ssize_t
+oci_trans_commit_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCISvcCtx *svchp = va_arg(ap, OCISvcCtx *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	*res = OCITransCommit(svchp, errhp, OCI_DEFAULT);
+	return 0;
+}
+
+static inline sword
+oci_trans_commit_coio(struct ora_stat *stat, OCISvcCtx *svchp,
+		      OCIError *errhp)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_trans_commit_cb, &res,
+		  svchp, errhp);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+static inline ssize_t
+oci_trans_rollback_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCISvcCtx *svchp = va_arg(ap, OCISvcCtx *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	*res = OCITransRollback(svchp, errhp, OCI_DEFAULT);
+	return 0;
+}
+
+static inline sword
+oci_trans_rollback_coio(struct ora_stat *stat, OCISvcCtx *svchp,
+			OCIError *errhp)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_trans_rollback_cb, &res,
+		  svchp, errhp);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+/**
+ * Execute statements of a batch in order until the first failure, its
+ * error is saved to the message before a rollback could overwrite it.
+ * A transactional batch is committed at the end or rolled back to its
+ * savepoint by the rollback statement on a failure. Count of succeeded
+ * statements is returned in executed.
+ */
+static inline ssize_t
+oci_batch_execute_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCISvcCtx *svchp = va_arg(ap, OCISvcCtx *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	struct ora_batch_item *items = va_arg(ap, struct ora_batch_item *);
+	uint32_t count = va_arg(ap, uint32_t);
+	int transactional = va_arg(ap, int);
+	OCIStmt *rollback = va_arg(ap, OCIStmt *);
+	uint32_t *executed = va_arg(ap, uint32_t *);
+	char *message = va_arg(ap, char *);
+	size_t message_len = va_arg(ap, size_t);
+	bool *info = va_arg(ap, bool *);
+
+	uint32_t idx;
+	*res = OCI_SUCCESS;
+	for (idx = 0; idx < count; ++idx) {
+		*res = OCIStmtExecute(svchp, items[idx].stmt.stmthp, errhp,
+				      items[idx].exec_count, 0, NULL, NULL,
+				      OCI_DEFAULT);
+		if (!checkerror(*res, errhp, message, message_len, info))
+			break;
+	}
+	*executed = idx;
+	if (!transactional)
+		return 0;
+
+	if (idx < count) {
+		(void) OCIStmtExecute(svchp, rollback, errhp, 1, 0, NULL, NULL,
+				      OCI_DEFAULT);
+	} else {
+		*res = OCITransCommit(svchp, errhp, OCI_DEFAULT);
+		(void) checkerror(*res, errhp, message, message_len, info);
+	}
 	return 0;
 }
 
 static inline sword
-oci_stmt_execute_coio(OCISvcCtx *svchp, OCIStmt *stmthp, OCIError *errhp,
-		      ub4 exec_count)
+oci_batch_execute_coio(struct ora_conn_ctx *conn, struct ora_batch_item *items,
+		       uint32_t count, bool transactional, OCIStmt *rollback,
+		       uint32_t *executed)
 {
 	sword res;
-	coio_call(oci_stmt_execute_cb, &res, svchp, stmthp, errhp, exec_count);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_batch_execute_cb, &res,
+		  conn->svchp, conn->errhp, items, count, (int)transactional,
+		  rollback, executed, conn->message, sizeof(conn->message), &conn->info);
+	ora_stat_coio(&conn->stat, &timing);
 	return res;
 }
 
@@ -41,10 +200,40 @@ oci_stmt_fetch_cb(va_list ap)
 }
 
 static inline sword
-oci_stmt_fetch_coio(OCIStmt *stmthp, OCIError *errhp, ub4 fetch_count)
+oci_stmt_fetch_coio(struct ora_stat *stat, OCIStmt *stmthp, OCIError *errhp,
+		    ub4 fetch_count)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_stmt_fetch_cb, &res,
+		  stmthp, errhp, fetch_count);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+static inline ssize_t
+oci_stmt_fetch2_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCIStmt *stmthp = va_arg(ap, OCIStmt *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	ub4 fetch_count = va_arg(ap, ub4);
+	*res = OCIStmtFetch2(stmthp, errhp, fetch_count, OCI_FETCH_NEXT, 0,
+			     OCI_DEFAULT);
+	return 0;
+}
+
+static inline sword
+oci_stmt_fetch2_coio(struct ora_stat *stat, OCIStmt *stmthp, OCIError *errhp,
+		     ub4 fetch_count)
 {
 	sword res;
-	coio_call(oci_stmt_fetch_cb, &res, stmthp, errhp, fetch_count);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_stmt_fetch2_cb, &res,
+		  stmthp, errhp, fetch_count);
+	ora_stat_coio(stat, &timing);
 	return res;
 }
 
@@ -65,12 +254,16 @@ oci_blob_read_cb(va_list ap)
 }
 
 static inline sword
-oci_blob_read_coio(OCISvcCtx *svchp, OCIError *errhp, OCIClobLocator *blob,
-		   void *buffer, ub4 *data_read, ub4 length)
+oci_blob_read_coio(struct ora_stat *stat, OCISvcCtx *svchp, OCIError *errhp,
+		   OCIClobLocator *blob, void *buffer, ub4 *data_read,
+		   ub4 length)
 {
 	sword res;
-	coio_call(oci_blob_read_cb, &res, svchp, errhp, blob, buffer,
-		  data_read, length);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_blob_read_cb, &res,
+		  svchp, errhp, blob, buffer, data_read, length);
+	ora_stat_coio(stat, &timing);
 	return res;
 }
 
@@ -92,12 +285,16 @@ oci_clob_read_cb(va_list ap)
 }
 
 static inline sword
-oci_clob_read_coio(OCISvcCtx *svchp, OCIError *errhp, OCIClobLocator *blob,
-		   void *buffer, ub4 *data_read, ub4 length, ub1 clob_cs)
+oci_clob_read_coio(struct ora_stat *stat, OCISvcCtx *svchp, OCIError *errhp,
+		   OCIClobLocator *blob, void *buffer, ub4 *data_read,
+		   ub4 length, ub1 clob_cs)
 {
 	sword res;
-	coio_call(oci_clob_read_cb, &res, svchp, errhp, blob, buffer,
-		  data_read, length, (unsigned int)clob_cs);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_clob_read_cb, &res,
+		  svchp, errhp, blob, buffer, data_read, length, (unsigned int)clob_cs);
+	ora_stat_coio(stat, &timing);
 	return res;
 }
 
@@ -114,11 +311,15 @@ oci_server_attach_cb(va_list ap)
 }
 
 static inline sword
-oci_server_attach_coio(OCIServer *srvhp, OCIError *errhp, text *dbname,
-		       sb4 dbname_len)
+oci_server_attach_coio(struct ora_stat *stat, OCIServer *srvhp,
+		       OCIError *errhp, text *dbname, sb4 dbname_len)
 {
 	sword res;
-	coio_call(oci_server_attach_cb, &res, srvhp, errhp, dbname, dbname_len);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_server_attach_cb, &res,
+		  srvhp, errhp, dbname, dbname_len);
+	ora_stat_coio(stat, &timing);
 	return res;
 }
 
@@ -134,10 +335,114 @@ oci_session_begin_cb(va_list ap)
 }
 
 static inline sword
-oci_session_begin_coio(OCISvcCtx *svchp, OCIError *errhp, OCISession *authp)
+oci_session_begin_coio(struct ora_stat *stat, OCISvcCtx *svchp,
+		       OCIError *errhp, OCISession *authp)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_session_begin_cb, &res,
+		  svchp, errhp, authp);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+static inline ssize_t
+oci_dirpath_prepare_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCIDirPathCtx *dpctx = va_arg(ap, OCIDirPathCtx *);
+	OCISvcCtx *svchp = va_arg(ap, OCISvcCtx *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	*res = OCIDirPathPrepare(dpctx, svchp, errhp);
+	return 0;
+}
+
+static inline sword
+oci_dirpath_prepare_coio(struct ora_stat *stat, OCIDirPathCtx *dpctx,
+			 OCISvcCtx *svchp, OCIError *errhp)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_dirpath_prepare_cb, &res,
+		  dpctx, svchp, errhp);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+/**
+ * Convert rows of a column array to streams and load them. A stream
+ * may not fit all the rows, then the rest is converted from the row
+ * the previous conversion has stopped at.
+ */
+static inline ssize_t
+oci_dirpath_load_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCIDirPathCtx *dpctx = va_arg(ap, OCIDirPathCtx *);
+	OCIDirPathColArray *dpca = va_arg(ap, OCIDirPathColArray *);
+	OCIDirPathStream *dpstr = va_arg(ap, OCIDirPathStream *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	ub4 rows = va_arg(ap, ub4);
+	ub4 offset = 0;
+	for (;;) {
+		*res = OCIDirPathStreamReset(dpstr, errhp);
+		if (*res != OCI_SUCCESS)
+			return 0;
+		sword conv = OCIDirPathColArrayToStream(dpca, dpctx, dpstr,
+							errhp, rows - offset,
+							offset);
+		if (conv != OCI_SUCCESS && conv != OCI_CONTINUE) {
+			*res = conv;
+			return 0;
+		}
+		*res = OCIDirPathLoadStream(dpctx, dpstr, errhp);
+		if (*res != OCI_SUCCESS || conv == OCI_SUCCESS)
+			return 0;
+		ub4 converted = 0;
+		*res = OCIAttrGet(dpca, OCI_HTYPE_DIRPATH_COLUMN_ARRAY,
+				  &converted, NULL, OCI_ATTR_ROW_COUNT, errhp);
+		if (*res != OCI_SUCCESS)
+			return 0;
+		offset += converted;
+	}
+}
+
+static inline sword
+oci_dirpath_load_coio(struct ora_stat *stat, OCIDirPathCtx *dpctx,
+		      OCIDirPathColArray *dpca, OCIDirPathStream *dpstr,
+		      OCIError *errhp, ub4 rows)
+{
+	sword res;
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_dirpath_load_cb, &res,
+		  dpctx, dpca, dpstr, errhp, rows);
+	ora_stat_coio(stat, &timing);
+	return res;
+}
+
+static inline ssize_t
+oci_dirpath_finish_cb(va_list ap)
+{
+	sword *res = va_arg(ap, sword *);
+	OCIDirPathCtx *dpctx = va_arg(ap, OCIDirPathCtx *);
+	OCIError *errhp = va_arg(ap, OCIError *);
+	*res = OCIDirPathFinish(dpctx, errhp);
+	return 0;
+}
+
+static inline sword
+oci_dirpath_finish_coio(struct ora_stat *stat, OCIDirPathCtx *dpctx,
+			OCIError *errhp)
 {
 	sword res;
-	coio_call(oci_session_begin_cb, &res, svchp, errhp, authp);
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, oci_dirpath_finish_cb, &res,
+		  dpctx, errhp);
+	ora_stat_coio(stat, &timing);
 	return res;
 }
 
@@ -0,0 +1,287 @@
+#include "batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef PACKAGE_VERSION
+#include <module.h>
+
+#include "types.h"
+#include "async.h"
+#include "bind.h"
+#include "define.h"
+#include "fetch.h"
+#include "stmt.h"
+#include "util.h"
+
+/**
+ * Prefix the error message with the position of the failed statement,
+ * the tail of a long message is cut.
+ */
+static void
+ora_batch_error(struct ora_conn_ctx *conn, uint32_t idx)
+{
+	char prefix[32];
+	int len = snprintf(prefix, sizeof(prefix), "statement %u: ", idx + 1);
+	size_t tail = strnlen(conn->message, sizeof(conn->message) - len - 1);
+	memmove(conn->message + len, conn->message, tail);
+	memcpy(conn->message, prefix, len);
+	conn->message[len + tail] = '\0';
+}
+
+/**
+ * Prepare and bind the statement of a {sql, binds} entry on top of lua
+ * stack. Bind values stay pinned by the entry until the batch is done.
+ */
+static int
+ora_batch_prepare(struct lua_State *L, struct ora_conn_ctx *conn,
+		  struct ora_batch_item *item)
+{
+	sword errcode;
+	int rc = -1;
+
+	lua_rawgeti(L, -1, 1);
+	const char *sql = lua_tostring(L, -1);
+	lua_rawgeti(L, -2, 2);
+	if (sql == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "statement should be {sql, binds}");
+		goto done;
+	}
+
+	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&conn->stmthp,
+				 OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto done;
+
+	errcode = OCIStmtPrepare(conn->stmthp, conn->errhp, (text *)sql,
+				 (ub4)strlen(sql),
+				 (ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto done;
+
+	ub2 stmt_type;
+	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&stmt_type,
+			     (ub4 *)0, (ub4)OCI_ATTR_STMT_TYPE,
+			     (OCIError *)conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto done;
+	item->stmt.stmt_type = stmt_type;
+	item->exec_count = stmt_type == OCI_STMT_SELECT ? 0 : 1;
+
+	if (lua_istable(L, -1)) {
+		if (ora_make_binds(L, lua_gettop(L), conn))
+			goto done;
+		if (ora_do_binds(conn, stmt_type, sql))
+			goto done;
+	}
+	rc = 0;
+
+done:
+	lua_pop(L, 2);
+	return rc;
+}
+
+/**
+ * Push the result of an executed statement of a batch: rows of a select
+ * or implicit results of PL/SQL, output variables and count of rows
+ * processed by DML.
+ */
+static int
+ora_batch_push_result(struct lua_State *L, struct ora_conn_ctx *conn,
+		      struct ora_batch_item *item)
+{
+	lua_createtable(L, 0, 3);
+	if (item->stmt.stmt_type == OCI_STMT_SELECT) {
+		if (ora_fetch_result(L, conn, conn->stmthp))
+			goto fail;
+		lua_setfield(L, -2, "rows");
+	} else {
+		int implicit = 0;
+		if (ora_stmt_is_plsql(item->stmt.stmt_type))
+			implicit = ora_fetch_implicit_results(L, conn);
+		if (implicit < 0)
+			goto fail;
+		if (implicit > 0)
+			lua_setfield(L, -2, "rows");
+
+		ub4 row_count = 0;
+		(void) OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&row_count,
+				  (ub4 *)0, (ub4)OCI_ATTR_ROW_COUNT,
+				  (OCIError *)conn->errhp);
+		lua_pushinteger(L, row_count);
+		lua_setfield(L, -2, "count");
+	}
+
+	int output = ora_push_binds(L, conn);
+	if (output < 0)
+		goto fail;
+	if (output > 0)
+		lua_setfield(L, -2, "output");
+	return 0;
+
+fail:
+	lua_pop(L, 1);
+	return -1;
+}
+
+static void
+ora_batch_free(struct lua_State *L, struct ora_conn_ctx *conn,
+	       struct ora_batch_item *items, uint32_t count)
+{
+	for (uint32_t idx = 0; idx < count; ++idx) {
+		struct ora_stmt *stmt = &items[idx].stmt;
+		ora_stmt_swap(conn, stmt);
+		if (conn->defines != NULL)
+			ora_free_defines(L, conn);
+		ora_destroy_binds(conn);
+		if (conn->stmthp != NULL)
+			(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
+		conn->stmthp = NULL;
+		ora_stmt_swap(conn, stmt);
+	}
+	free(items);
+}
+
+/**
+ * Prepare a statement without binds
+ */
+static OCIStmt *
+ora_batch_prepare_sql(struct ora_conn_ctx *conn, const char *sql)
+{
+	OCIStmt *stmthp = NULL;
+	sword errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&stmthp,
+				       OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return NULL;
+
+	errcode = OCIStmtPrepare(stmthp, conn->errhp, (text *)sql,
+				 (ub4)strlen(sql),
+				 (ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+		(void) OCIHandleFree((dvoid *)stmthp, (ub4)OCI_HTYPE_STMT);
+		return NULL;
+	}
+	return stmthp;
+}
+
+/**
+ * Set a savepoint before a transactional batch and prepare the rollback
+ * to it, so a failure undoes the batch only and keeps the work done
+ * earlier in the transaction.
+ */
+static OCIStmt *
+ora_batch_savepoint(struct ora_conn_ctx *conn)
+{
+	OCIStmt *savepoint = ora_batch_prepare_sql(conn, "SAVEPOINT ora_batch");
+	if (savepoint == NULL)
+		return NULL;
+	sword errcode = oci_stmt_execute_coio(&conn->stat, conn->svchp,
+					      savepoint, conn->errhp, 1,
+					      OCI_DEFAULT);
+	(void) OCIHandleFree((dvoid *)savepoint, (ub4)OCI_HTYPE_STMT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return NULL;
+	return ora_batch_prepare_sql(conn, "ROLLBACK TO SAVEPOINT ora_batch");
+}
+
+/**
+ * Run a list of {sql, binds} statements. All of them are prepared and
+ * bound first, then executed in order by one worker thread job which
+ * stops at the first failure. A transactional batch is committed by the
+ * same job or rolled back to the savepoint taken before it on a failure.
+ * Pushes an array of results.
+ */
+int
+ora_batch_execute(struct lua_State *L, struct ora_conn_ctx *conn,
+		  int list_idx, bool transactional)
+{
+	uint32_t count = (uint32_t)lua_objlen(L, list_idx);
+	uint32_t prepared = 0;
+	struct ora_batch_item *items = NULL;
+	OCIStmt *rollback = NULL;
+	if (count == 0) {
+		lua_newtable(L);
+		return 0;
+	}
+
+	items = (struct ora_batch_item *)calloc(count, sizeof(*items));
+	if (items == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not allocate %zu bytes", count * sizeof(*items));
+		return -1;
+	}
+
+	double phase = clock_monotonic();
+	for (; prepared < count; ++prepared) {
+		struct ora_batch_item *item = items + prepared;
+		item->stmt.define_rows = 1;
+		item->stmt.define_sets = 1;
+		lua_rawgeti(L, list_idx, prepared + 1);
+		ora_stmt_swap(conn, &item->stmt);
+		int rc = -1;
+		if (lua_istable(L, -1))
+			rc = ora_batch_prepare(L, conn, item);
+		else
+			snprintf(conn->message, sizeof(conn->message), "%s",
+				 "statement should be {sql, binds}");
+		ora_stmt_swap(conn, &item->stmt);
+		lua_pop(L, 1);
+		if (rc) {
+			ora_batch_error(conn, prepared);
+			++prepared;
+			goto fail_prepare;
+		}
+		conn->timing.binds += items[prepared].stmt.bind_count;
+		conn->stat.binds += items[prepared].stmt.bind_count;
+	}
+	conn->timing.bind = clock_monotonic() - phase;
+
+	if (transactional) {
+		rollback = ora_batch_savepoint(conn);
+		if (rollback == NULL)
+			goto fail;
+	}
+
+	uint32_t executed = 0;
+	phase = clock_monotonic();
+	sword errcode = oci_batch_execute_coio(conn, items, count,
+					       transactional, rollback,
+					       &executed);
+	conn->timing.execute = clock_monotonic() - phase;
+	conn->stat.executes += executed < count ? executed + 1 : executed;
+	if (executed < count) {
+		ora_batch_error(conn, executed);
+		goto fail;
+	}
+	if (errcode != OCI_SUCCESS && errcode != OCI_SUCCESS_WITH_INFO)
+		goto fail;
+
+	lua_createtable(L, count, 0);
+	for (uint32_t idx = 0; idx < count; ++idx) {
+		ora_stmt_swap(conn, &items[idx].stmt);
+		int rc = ora_batch_push_result(L, conn, items + idx);
+		ora_stmt_swap(conn, &items[idx].stmt);
+		if (rc) {
+			lua_pop(L, 1);
+			ora_batch_error(conn, idx);
+			goto fail;
+		}
+		lua_rawseti(L, -2, idx + 1);
+	}
+	(void) OCIHandleFree((dvoid *)rollback, (ub4)OCI_HTYPE_STMT);
+	ora_batch_free(L, conn, items, count);
+	return 0;
+
+fail_prepare:
+	/* nothing is executed yet */
+	ora_batch_free(L, conn, items, prepared);
+	return -1;
+
+fail:
+	if (rollback != NULL)
+		(void) OCIHandleFree((dvoid *)rollback, (ub4)OCI_HTYPE_STMT);
+	ora_batch_free(L, conn, items, count);
+	return -1;
+}
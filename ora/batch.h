@@ -0,0 +1,15 @@
+#ifndef ORA_BATCH_H
+#define ORA_BATCH_H
+
+#include <stdbool.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "types.h"
+
+int
+ora_batch_execute(struct lua_State *L, struct ora_conn_ctx *conn,
+		  int list_idx, bool transactional);
+
+#endif
@@ -2,10 +2,25 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+
+#undef PACKAGE_VERSION
+#include <module.h>
+#include <msgpuck.h>
 
 #include "types.h"
+#include "fetch.h"
 #include "util.h"
 
+static uint32_t CTID_INT64;
+static uint32_t CTID_UINT64;
+
+void
+ora_binds_init(struct lua_State *L) {
+	CTID_INT64 = luaL_ctypeid(L, "int64_t");
+	CTID_UINT64 = luaL_ctypeid(L, "uint64_t");
+}
+
 void
 ora_free_binds(struct ora_conn_ctx *conn) {
 	for (uint32_t idx = 0; idx < conn->bind_count; ++idx)
@@ -13,149 +28,411 @@ ora_free_binds(struct ora_conn_ctx *conn) {
 		struct ora_bind *bind = conn->binds + idx;
 		if (bind->bindhp)
 			(void) OCIHandleFree((dvoid *)bind->bindhp, (ub4)OCI_HTYPE_BIND);
-		switch (bind->type) {
-		case SQLT_AFC:
-			free(bind->string.value);
-			break;
-		}
-		for (uint32_t idx = 0; idx < bind->rowsret; ++idx) {
-			struct ora_bind_return *ret = bind->returns + idx;
-			switch (bind->type) {
-			case SQLT_AFC:
-				free(ret->string);
-				break;
-			}
-		}
-		free(bind->returns);
+		bind->bindhp = NULL;
+		if (bind->type == SQLT_RSET && bind->cursor != NULL)
+			(void) OCIHandleFree((dvoid *)bind->cursor, (ub4)OCI_HTYPE_STMT);
+		bind->type = 0;
 		bind->rowsret = 0;
+		bind->iters = 0;
+	}
+	conn->bind_count = 0;
+}
+
+void
+ora_destroy_binds(struct ora_conn_ctx *conn) {
+	ora_free_binds(conn);
+	for (uint32_t idx = 0; idx < conn->bind_capacity; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		free(bind->returns);
+		free(bind->strings);
+		free(bind->values);
 	}
 	free(conn->binds);
 	conn->binds = (struct ora_bind *)NULL;
-	conn->bind_count = 0;
+	conn->bind_capacity = 0;
 }
 
-int
-ora_make_binds(struct lua_State *L, int params_table, struct ora_conn_ctx *conn) {
-	lua_pushnil(L);  /* first key */
-	while (lua_next(L, params_table) != 0) {
-		struct ora_bind *binds =
-			(struct ora_bind *)realloc(conn->binds,
-						   sizeof(struct ora_bind) *
-						   (conn->bind_count + 1));
-		if (binds == NULL)
-			goto fail_bind;
+static int
+ora_reserve_binds(struct ora_conn_ctx *conn, uint32_t count) {
+	if (count <= conn->bind_capacity)
+		return 0;
 
-		conn->binds = binds;
-		struct ora_bind *bind = conn->binds + conn->bind_count;
+	struct ora_bind *binds =
+		(struct ora_bind *)realloc(conn->binds,
+					   sizeof(struct ora_bind) * count);
+	if (binds == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not allocate %zu bytes",
+			 sizeof(struct ora_bind) * count);
+		return -1;
+	}
+	memset(binds + conn->bind_capacity, 0,
+	       sizeof(struct ora_bind) * (count - conn->bind_capacity));
+	conn->binds = binds;
+	conn->bind_capacity = count;
+	return 0;
+}
 
-		bind->conn = conn;
-		bind->type = 0;
-		bind->alen = 0;
-		bind->ind = -1;
-		bind->string.value = NULL;
-		bind->string.len = 0;
-		bind->bindhp = NULL;
-		bind->returns = NULL;
-		bind->rowsret = 0;
+/**
+ * Make room for size bytes of strings of a bind
+ */
+static int
+ora_reserve_strings(struct ora_bind *bind, size_t size) {
+	if (size <= bind->strings_size)
+		return 0;
+	size_t cap = bind->strings_size > 0 ? bind->strings_size : bind->alen;
+	while (cap < size)
+		cap *= 2;
+	char *strings = (char *)realloc(bind->strings, cap);
+	if (strings == NULL) {
+		snprintf(bind->conn->message, sizeof(bind->conn->message),
+			 "could not allocate %zu bytes", cap);
+		return -1;
+	}
+	bind->strings = strings;
+	bind->strings_size = cap;
+	return 0;
+}
 
-		bind->bind_name = lua_tolstring(L, -2, &bind->bind_name_len);
+/**
+ * Make room for rows output values of a bind
+ */
+static int
+ora_reserve_returns(struct ora_bind *bind, ub4 rows) {
+	if (rows > bind->returns_cap) {
+		ub4 cap = bind->returns_cap > 0 ? bind->returns_cap : 1;
+		while (cap < rows)
+			cap *= 2;
+		struct ora_bind_return *returns =
+			(struct ora_bind_return *)realloc(bind->returns,
+							  sizeof(struct ora_bind_return) * cap);
+		if (returns == NULL) {
+			snprintf(bind->conn->message, sizeof(bind->conn->message),
+				 "could not allocate %zu bytes",
+				 sizeof(struct ora_bind_return) * cap);
+			return -1;
+		}
+		bind->returns = returns;
+		bind->returns_cap = cap;
+	}
 
-		if (lua_istable(L, -1)) {
+	if ((bind->type == SQLT_AFC || bind->type == SQLT_BIN) &&
+	    ora_reserve_strings(bind, (size_t)bind->alen * rows))
+		return -1;
+	return 0;
+}
 
-			lua_pushstring(L, "value");
-			lua_gettable(L, -2);
-			if (lua_isnil(L, -1)) {
-				bind->ind = -1;
-			} else {
-				bind->ind = 0;
-				switch (lua_type(L, -1)) {
-				case LUA_TNUMBER:
-					bind->type = SQLT_VNU;
-					bind->alen = sizeof(bind->number);
-					double number = lua_tonumber(L, -1);
-					OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
-
-					break;
-				case LUA_TBOOLEAN:
-					bind->type = SQLT_UIN;
-					bind->alen = sizeof(bind->uint64);
-
-					break;
-				case LUA_TSTRING:
-				default:
-					bind->type = SQLT_AFC;
-					size_t len;
-					const char *value = lua_tolstring(L, -1, &len);
-					bind->alen = len;
-					bind->string.value = (char *)malloc(bind->alen);
-					if (bind->string.value == NULL) {
-						snprintf(conn->message, sizeof(conn->message), "could not allocate %u bytes", bind->alen);
-						goto fail_bind;
-					}
-					bind->string.len = len;
-					memcpy(bind->string.value, value, bind->alen);
+/**
+ * Bind int64_t/uint64_t cdata or an integral lua number as an 8-byte
+ * integer, which is exact and needs no OCINumber conversion.
+ */
+static bool
+ora_bind_integer(struct lua_State *L, int idx, struct ora_bind *bind) {
+	if (luaL_iscdata(L, idx)) {
+		uint32_t ctypeid;
+		void *data = luaL_checkcdata(L, idx, &ctypeid);
+		if (ctypeid == CTID_INT64) {
+			bind->type = SQLT_INT;
+			bind->int64 = *(int64_t *)data;
+		} else if (ctypeid == CTID_UINT64) {
+			bind->type = SQLT_UIN;
+			bind->uint64 = *(uint64_t *)data;
+		} else {
+			return false;
+		}
+	} else if (lua_type(L, idx) == LUA_TNUMBER) {
+		double number = lua_tonumber(L, idx);
+		if (!(number >= -9223372036854775808.0 &&
+		      number < 9223372036854775808.0) ||
+		    number != (double)(int64_t)number)
+			return false;
+		bind->type = SQLT_INT;
+		bind->int64 = (int64_t)number;
+	} else {
+		return false;
+	}
+	bind->alen = sizeof(bind->int64);
+	return true;
+}
 
-					break;
-				}
-			}
-			lua_pop(L, 1);
+/**
+ * Fill a bind from the parameter value on top of lua stack. Strings are
+ * bound without copying: params table is kept on lua stack until the
+ * statement is executed, so the values stay pinned.
+ */
+static void
+ora_make_bind(struct lua_State *L, struct ora_conn_ctx *conn,
+	      struct ora_bind *bind) {
+	bind->conn = conn;
+	bind->type = 0;
+	bind->alen = 0;
+	bind->ind = -1;
+	bind->string.value = NULL;
+	bind->string.len = 0;
+	bind->bindhp = NULL;
+	bind->rowsret = 0;
+	bind->max_rows = 0;
+	bind->output = false;
+	bind->iters = 0;
 
-			if (bind->type == 0) {
-				lua_pushstring(L, "type");
-				lua_gettable(L, -2);
-				const char *value = lua_tostring(L, -1);
-				if (value == NULL) {
-					bind->type = SQLT_AFC;
-				} else if (strncmp(value, "string", strlen("string")) == 0) {
-					bind->type = SQLT_AFC;
-				} else if (strncmp(value, "number", strlen("number")) == 0) {
-					bind->type = SQLT_VNU;
-					bind->alen = sizeof(bind->number);
-					double number = lua_tonumber(L, -1);
-					OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
-				} else {
-					// Using string implicitly
-					bind->type = SQLT_AFC;
-				}
-				lua_pop(L, 1);
-			}
+	if (lua_istable(L, -1)) {
 
-			if (bind->type == SQLT_AFC) {
-				lua_pushstring(L, "size");
-				lua_gettable(L, -2);
-				if (lua_isnumber(L, -1) == 1) {
-					bind->alen = lua_tointeger(L, -1);
-				}
-				lua_pop(L, 1);
-			}
+		lua_pushstring(L, "type");
+		lua_gettable(L, -2);
+		/* the string is kept by the parameter table */
+		const char *type = lua_tostring(L, -1);
+		lua_pop(L, 1);
+		bool int64 = type != NULL &&
+			strncmp(type, "int64", strlen("int64")) == 0;
+		bool raw = type != NULL &&
+			strncmp(type, "raw", strlen("raw")) == 0;
 
-		} else if (lua_isboolean(L, -1)) {
-			bind->uint64 = lua_toboolean(L, -1) ? 1 : 0;
-			bind->type = SQLT_UIN;
+		/* ref cursor opened by PL/SQL, its rows are returned */
+		if (type != NULL &&
+		    strncmp(type, "cursor", strlen("cursor")) == 0) {
+			bind->type = SQLT_RSET;
 			bind->ind = 0;
-			bind->alen = sizeof(bind->uint64);
+			bind->output = true;
+			return;
+		}
 
-		} else if (lua_type(L, -1) == LUA_TNUMBER) {
-			bind->type = SQLT_VNU;
+		lua_pushstring(L, "value");
+		lua_gettable(L, -2);
+		if (lua_isnil(L, -1)) {
+			bind->ind = -1;
+			bind->output = true;
+		} else if (int64) {
+			bind->ind = 0;
+			bind->type = SQLT_INT;
+			bind->alen = sizeof(bind->int64);
+			bind->int64 = luaL_toint64(L, -1);
+		} else if (raw) {
+			bind->type = SQLT_BIN;
+			bind->string.value = lua_tolstring(L, -1, &bind->string.len);
+			bind->alen = bind->string.len;
+			bind->ind = bind->string.value == NULL ? -1 : 0;
+		} else if (ora_bind_integer(L, -1, bind)) {
 			bind->ind = 0;
-			bind->alen = sizeof(bind->number);
-			double number = lua_tonumber(L, -1);
-			OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
 		} else {
-			size_t len;
-			const char *value = lua_tolstring(L, -1, &len);
-			bind->alen = len;
-			bind->string.value = (char *)malloc(bind->alen);
-			if (bind->string.value == NULL) {
-				snprintf(conn->message, sizeof(conn->message), "could not allocate %u bytes", bind->alen);
-				goto fail_bind;
+			bind->ind = 0;
+			switch (lua_type(L, -1)) {
+			case LUA_TNUMBER:
+				bind->type = SQLT_VNU;
+				bind->alen = sizeof(bind->number);
+				double number = lua_tonumber(L, -1);
+				OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
+
+				break;
+			case LUA_TBOOLEAN:
+				bind->type = SQLT_UIN;
+				bind->alen = sizeof(bind->uint64);
+				bind->uint64 = lua_toboolean(L, -1) ? 1 : 0;
+
+				break;
+			case LUA_TSTRING:
+			default:
+				bind->type = SQLT_AFC;
+				bind->string.value = lua_tolstring(L, -1, &bind->string.len);
+				bind->alen = bind->string.len;
+				if (bind->string.value == NULL)
+					bind->ind = -1;
+
+				break;
 			}
-			bind->string.len = len;
-			memcpy(bind->string.value, value, bind->alen);
+		}
+		lua_pop(L, 1);
 
-			bind->type = SQLT_AFC;
-			bind->ind = 0;
+		if (bind->type == 0) {
+			if (type == NULL) {
+				bind->type = SQLT_AFC;
+			} else if (strncmp(type, "string", strlen("string")) == 0) {
+				bind->type = SQLT_AFC;
+			} else if (strncmp(type, "number", strlen("number")) == 0) {
+				bind->type = SQLT_VNU;
+				bind->alen = sizeof(bind->number);
+				double number = 0;
+				OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
+			} else if (int64) {
+				bind->type = SQLT_INT;
+				bind->alen = sizeof(bind->int64);
+			} else if (raw) {
+				bind->type = SQLT_BIN;
+			} else {
+				// Using string implicitly
+				bind->type = SQLT_AFC;
+			}
+		}
+
+		lua_pushstring(L, "max_rows");
+		lua_gettable(L, -2);
+		if (lua_isnumber(L, -1) == 1 && lua_tointeger(L, -1) > 0) {
+			bind->max_rows = lua_tointeger(L, -1);
+		}
+		lua_pop(L, 1);
+
+		if (bind->type == SQLT_AFC || bind->type == SQLT_BIN) {
+			lua_pushstring(L, "size");
+			lua_gettable(L, -2);
+			if (lua_isnumber(L, -1) == 1) {
+				bind->alen = lua_tointeger(L, -1);
+			}
+			lua_pop(L, 1);
+		}
+
+	} else if (lua_isboolean(L, -1)) {
+		bind->uint64 = lua_toboolean(L, -1) ? 1 : 0;
+		bind->type = SQLT_UIN;
+		bind->ind = 0;
+		bind->alen = sizeof(bind->uint64);
+
+	} else if (ora_bind_integer(L, -1, bind)) {
+		bind->ind = 0;
+	} else if (lua_type(L, -1) == LUA_TNUMBER) {
+		bind->type = SQLT_VNU;
+		bind->ind = 0;
+		bind->alen = sizeof(bind->number);
+		double number = lua_tonumber(L, -1);
+		OCINumberFromReal(conn->errhp, &number, sizeof(number), &bind->number);
+	} else {
+		bind->string.value = lua_tolstring(L, -1, &bind->string.len);
+		bind->alen = bind->string.len;
+		bind->type = SQLT_AFC;
+		bind->ind = bind->string.value == NULL ? -1 : 0;
+	}
+}
+
+/**
+ * Count of bind positions of the prepared statement
+ */
+static int
+ora_bind_positions(struct ora_conn_ctx *conn, uint32_t *count) {
+	ub4 positions = 0;
+	sword errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT,
+				   (void *)&positions, (ub4 *)0,
+				   (ub4)OCI_ATTR_BIND_COUNT, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	*count = positions;
+	return 0;
+}
+
+/**
+ * Placeholder names are matched as OCIBindByName does: without case and
+ * the optional colon.
+ */
+static bool
+ora_bind_has_name(struct ora_conn_ctx *conn, const char *name, size_t len) {
+	for (uint32_t idx = 0; idx < conn->bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		const char *bind_name = bind->bind_name;
+		size_t bind_name_len = bind->bind_name_len;
+		if (bind_name == NULL)
+			continue;
+		if (bind_name_len > 0 && bind_name[0] == ':') {
+			++bind_name;
+			--bind_name_len;
+		}
+		if (bind_name_len == len &&
+		    strncasecmp(bind_name, name, len) == 0)
+			return true;
+	}
+	return false;
+}
+
+#define ORA_BIND_INFO_SIZE 32
+
+/**
+ * Append binds by name for placeholders of the statement which have no
+ * bind yet, so that a parameter missing from a map binds NULL the same
+ * way a nil value would. Only names are set, they point into the
+ * statement handle.
+ */
+static int
+ora_bind_placeholders(struct ora_conn_ctx *conn) {
+	OraText *names[ORA_BIND_INFO_SIZE];
+	ub1 name_lens[ORA_BIND_INFO_SIZE];
+	OraText *ind_names[ORA_BIND_INFO_SIZE];
+	ub1 ind_name_lens[ORA_BIND_INFO_SIZE];
+	ub1 dups[ORA_BIND_INFO_SIZE];
+	OCIBind *handles[ORA_BIND_INFO_SIZE];
+	ub4 start = 1;
+	ub4 total = 0;
+
+	do {
+		sb4 found = 0;
+		sword errcode = OCIStmtGetBindInfo(conn->stmthp, conn->errhp,
+						   ORA_BIND_INFO_SIZE, start,
+						   &found, names, name_lens,
+						   ind_names, ind_name_lens,
+						   dups, handles);
+		/* the statement has no placeholders */
+		if (errcode == OCI_NO_DATA)
+			return 0;
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+		/* negative if there are more than fit into the arrays */
+		total = found < 0 ? (ub4)-found : (ub4)found;
+		ub4 chunk = total - start + 1;
+		if (chunk > ORA_BIND_INFO_SIZE)
+			chunk = ORA_BIND_INFO_SIZE;
+
+		for (ub4 idx = 0; idx < chunk; ++idx) {
+			if (dups[idx] ||
+			    ora_bind_has_name(conn, (const char *)names[idx],
+					      name_lens[idx]))
+				continue;
+			if (ora_reserve_binds(conn, conn->bind_count + 1))
+				return -1;
+			struct ora_bind *bind = conn->binds + conn->bind_count;
+			bind->bind_name = (const char *)names[idx];
+			bind->bind_name_len = name_lens[idx];
+			bind->pos = 0;
+			++conn->bind_count;
+		}
+		start += ORA_BIND_INFO_SIZE;
+	} while (start <= total);
+	return 0;
+}
+
+/**
+ * Parameters are bound by name if params is a map or by position if it
+ * is an array, in the latter case the hash part is ignored.
+ */
+int
+ora_make_binds(struct lua_State *L, int params_table, struct ora_conn_ctx *conn) {
+	uint32_t count = (uint32_t)lua_objlen(L, params_table);
+	if (count > 0) {
+		if (ora_reserve_binds(conn, count))
+			goto fail_bind;
+
+		for (uint32_t pos = 1; pos <= count; ++pos) {
+			struct ora_bind *bind = conn->binds + conn->bind_count;
+			lua_rawgeti(L, params_table, pos);
+			ora_make_bind(L, conn, bind);
+			bind->bind_name = NULL;
+			bind->bind_name_len = 0;
+			bind->pos = pos;
+			lua_pop(L, 1);
+
+			++conn->bind_count;
 		}
+		return 0;
+	}
+
+	lua_pushnil(L);
+	while (lua_next(L, params_table) != 0) {
+		++count;
+		lua_pop(L, 1);
+	}
+	if (ora_reserve_binds(conn, count))
+		goto fail_bind;
+
+	lua_pushnil(L);  /* first key */
+	while (lua_next(L, params_table) != 0) {
+		struct ora_bind *bind = conn->binds + conn->bind_count;
+		ora_make_bind(L, conn, bind);
+		bind->bind_name = lua_tolstring(L, -2, &bind->bind_name_len);
+		bind->pos = 0;
 		lua_pop(L, 1);
 
 		++conn->bind_count;
@@ -168,17 +445,428 @@ fail_bind:
 	return -1;
 }
 
+/**
+ * Bind NULL to placeholders of a prepared statement which the params of
+ * its first execution miss, so that later executions could pass them:
+ * positions up to the bind count for an array, placeholder names for a
+ * map. Plain statements report them as ORA-01008 instead.
+ */
+int
+ora_make_missing_binds(struct lua_State *L, struct ora_conn_ctx *conn) {
+	uint32_t first = conn->bind_count;
+	bool by_pos = first > 0 && conn->binds[0].bind_name == NULL;
+	if (by_pos) {
+		uint32_t positions = 0;
+		if (ora_bind_positions(conn, &positions))
+			return -1;
+		if (positions > first && ora_reserve_binds(conn, positions))
+			return -1;
+		for (uint32_t pos = first + 1; pos <= positions; ++pos) {
+			struct ora_bind *bind = conn->binds + conn->bind_count;
+			bind->bind_name = NULL;
+			bind->bind_name_len = 0;
+			bind->pos = pos;
+			++conn->bind_count;
+		}
+	} else if (ora_bind_placeholders(conn)) {
+		return -1;
+	}
+
+	for (uint32_t idx = first; idx < conn->bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		const char *name = bind->bind_name;
+		size_t name_len = bind->bind_name_len;
+		ub4 pos = bind->pos;
+		lua_pushnil(L);
+		ora_make_bind(L, conn, bind);
+		bind->bind_name = name;
+		bind->bind_name_len = name_len;
+		bind->pos = pos;
+		lua_pop(L, 1);
+	}
+	return 0;
+}
+
+/**
+ * Make room for values of count iterations of an array bind
+ */
+static int
+ora_reserve_values(struct ora_bind *bind, ub4 count) {
+	if (count <= bind->values_cap)
+		return 0;
+	ub4 cap = bind->values_cap > 0 ? bind->values_cap : 1;
+	while (cap < count)
+		cap *= 2;
+	struct ora_bind_value *values =
+		(struct ora_bind_value *)realloc(bind->values,
+						 sizeof(struct ora_bind_value) * cap);
+	if (values == NULL) {
+		snprintf(bind->conn->message, sizeof(bind->conn->message),
+			 "could not allocate %zu bytes",
+			 sizeof(struct ora_bind_value) * cap);
+		return -1;
+	}
+	bind->values = values;
+	bind->values_cap = cap;
+	return 0;
+}
+
+/**
+ * Decode a lua value of an array bind. Returns false for a value of
+ * unsupported type.
+ */
+static bool
+ora_array_value_lua(struct lua_State *L, int idx, struct ora_bind_value *value) {
+	struct ora_bind scalar;
+	value->ind = 0;
+	if (ora_bind_integer(L, idx, &scalar)) {
+		value->type = scalar.type;
+		value->int64 = scalar.int64;
+		return true;
+	}
+	switch (lua_type(L, idx)) {
+	case LUA_TNIL:
+		value->type = 0;
+		value->ind = -1;
+		return true;
+	case LUA_TNUMBER:
+		value->type = SQLT_FLT;
+		value->real = lua_tonumber(L, idx);
+		return true;
+	case LUA_TBOOLEAN:
+		value->type = SQLT_UIN;
+		value->uint64 = lua_toboolean(L, idx);
+		return true;
+	case LUA_TSTRING:
+		value->type = SQLT_AFC;
+		value->string.value = lua_tolstring(L, idx, &value->string.len);
+		return true;
+	default:
+		if (luaL_iscdata(L, idx)) {
+			/* box.NULL */
+			uint32_t ctypeid;
+			void *data = luaL_checkcdata(L, idx, &ctypeid);
+			if (*(void **)data == NULL) {
+				value->type = 0;
+				value->ind = -1;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+/**
+ * Decode a msgpack tuple field of an array bind. Strings point into the
+ * tuple which is pinned by the rows table.
+ */
+static bool
+ora_array_value_mp(const char *field, struct ora_bind_value *value) {
+	uint32_t len;
+	value->ind = 0;
+	if (field == NULL) {
+		value->type = 0;
+		value->ind = -1;
+		return true;
+	}
+	switch (mp_typeof(*field)) {
+	case MP_NIL:
+		value->type = 0;
+		value->ind = -1;
+		return true;
+	case MP_UINT:
+		value->type = SQLT_UIN;
+		value->uint64 = mp_decode_uint(&field);
+		return true;
+	case MP_INT:
+		value->type = SQLT_INT;
+		value->int64 = mp_decode_int(&field);
+		return true;
+	case MP_FLOAT:
+		value->type = SQLT_FLT;
+		value->real = mp_decode_float(&field);
+		return true;
+	case MP_DOUBLE:
+		value->type = SQLT_FLT;
+		value->real = mp_decode_double(&field);
+		return true;
+	case MP_BOOL:
+		value->type = SQLT_UIN;
+		value->uint64 = mp_decode_bool(&field);
+		return true;
+	case MP_STR:
+		value->type = SQLT_AFC;
+		value->string.value = mp_decode_str(&field, &len);
+		value->string.len = len;
+		return true;
+	case MP_BIN:
+		value->type = SQLT_BIN;
+		value->string.value = mp_decode_bin(&field, &len);
+		value->string.len = len;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool
+ora_is_numeric(ub2 type) {
+	return type == SQLT_INT || type == SQLT_UIN || type == SQLT_FLT ||
+	       type == SQLT_VNU;
+}
+
+/**
+ * Merge the type of a bind with the type of one more value: numbers of
+ * different kinds are bound as Oracle NUMBER, other mixes are errors.
+ */
+static bool
+ora_merge_type(struct ora_bind *bind, ub2 type) {
+	if (type == 0 || type == bind->type)
+		return true;
+	if (bind->type == 0)
+		bind->type = type;
+	else if (ora_is_numeric(bind->type) && ora_is_numeric(type))
+		bind->type = SQLT_VNU;
+	else
+		return false;
+	return true;
+}
+
+/**
+ * Convert decoded values to the type of the bind.
+ */
+static int
+ora_convert_values(struct ora_conn_ctx *conn, struct ora_bind *bind) {
+	if (bind->type == SQLT_FLT)
+		bind->type = SQLT_VNU;
+	switch (bind->type) {
+	case 0:
+		bind->type = SQLT_AFC;
+		bind->alen = 1;
+		return 0;
+	case SQLT_INT:
+	case SQLT_UIN:
+		bind->alen = sizeof(int64_t);
+		return 0;
+	case SQLT_AFC:
+	case SQLT_BIN:
+		bind->alen = 1;
+		for (ub4 iter = 0; iter < bind->iters; ++iter) {
+			struct ora_bind_value *value = bind->values + iter;
+			if (value->ind == 0 && value->string.len > bind->alen)
+				bind->alen = value->string.len;
+		}
+		return 0;
+	}
+
+	bind->alen = sizeof(OCINumber);
+	for (ub4 iter = 0; iter < bind->iters; ++iter) {
+		struct ora_bind_value *value = bind->values + iter;
+		sword errcode = OCI_SUCCESS;
+		if (value->ind != 0)
+			continue;
+		if (value->type == SQLT_INT) {
+			int64_t int64 = value->int64;
+			errcode = OCINumberFromInt(conn->errhp, &int64,
+						   sizeof(int64),
+						   OCI_NUMBER_SIGNED,
+						   &value->number);
+		} else if (value->type == SQLT_UIN) {
+			uint64_t uint64 = value->uint64;
+			errcode = OCINumberFromInt(conn->errhp, &uint64,
+						   sizeof(uint64),
+						   OCI_NUMBER_UNSIGNED,
+						   &value->number);
+		} else if (value->type == SQLT_FLT) {
+			double real = value->real;
+			errcode = OCINumberFromReal(conn->errhp, &real,
+						    sizeof(real),
+						    &value->number);
+		}
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+		value->type = SQLT_VNU;
+	}
+	return 0;
+}
+
+/**
+ * Bind count rows of parameters for an array DML. Rows are either arrays
+ * or tuples bound by position, or maps bound by name, as the first row
+ * is. Every placeholder of the statement is bound, a missing value is
+ * NULL. Every bind gets a single type for all rows, decided by the
+ * values it has.
+ */
+int
+ora_make_array_binds(struct lua_State *L, int rows_table, ub4 count,
+		     struct ora_conn_ctx *conn) {
+	lua_rawgeti(L, rows_table, 1);
+	box_tuple_t *tuple = luaT_istuple(L, -1);
+	bool by_name = false;
+	if (tuple == NULL && !lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "rows should be tables or tuples");
+		return -1;
+	}
+	if (tuple == NULL && lua_objlen(L, -1) == 0) {
+		/* a map, or an array starting with nil */
+		lua_pushnil(L);
+		while (!by_name && lua_next(L, -2) != 0) {
+			by_name = lua_type(L, -2) == LUA_TSTRING;
+			lua_pop(L, 1);
+		}
+		if (by_name)
+			lua_pop(L, 1);
+	}
+
+	uint32_t bind_count = 0;
+	conn->bind_count = 0;
+	if (by_name) {
+		/* names are pinned by the first row */
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			lua_pop(L, 1);
+			if (lua_type(L, -1) != LUA_TSTRING) {
+				lua_pop(L, 2);
+				snprintf(conn->message, sizeof(conn->message), "%s",
+					 "parameter names should be strings");
+				return -1;
+			}
+			if (ora_reserve_binds(conn, conn->bind_count + 1)) {
+				lua_pop(L, 2);
+				return -1;
+			}
+			struct ora_bind *bind = conn->binds + conn->bind_count++;
+			bind->bind_name = lua_tolstring(L, -1, &bind->bind_name_len);
+			bind->pos = 0;
+		}
+		if (ora_bind_placeholders(conn)) {
+			lua_pop(L, 1);
+			return -1;
+		}
+		bind_count = conn->bind_count;
+	} else {
+		if (ora_bind_positions(conn, &bind_count) ||
+		    ora_reserve_binds(conn, bind_count)) {
+			lua_pop(L, 1);
+			return -1;
+		}
+		for (uint32_t idx = 0; idx < bind_count; ++idx) {
+			struct ora_bind *bind = conn->binds + idx;
+			bind->bind_name = NULL;
+			bind->bind_name_len = 0;
+			bind->pos = idx + 1;
+		}
+	}
+	lua_pop(L, 1);
+
+	for (uint32_t idx = 0; idx < bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		bind->conn = conn;
+		bind->type = 0;
+		bind->alen = 0;
+		bind->ind = 0;
+		bind->bindhp = NULL;
+		bind->rowsret = 0;
+		bind->max_rows = 0;
+		bind->output = false;
+		bind->iters = count;
+		if (ora_reserve_values(bind, count))
+			return -1;
+	}
+	conn->bind_count = bind_count;
+
+	for (ub4 iter = 0; iter < count; ++iter) {
+		lua_rawgeti(L, rows_table, iter + 1);
+		tuple = luaT_istuple(L, -1);
+		if (tuple == NULL && !lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			snprintf(conn->message, sizeof(conn->message),
+				 "row %u is neither a table nor a tuple", iter + 1);
+			return -1;
+		}
+		uint32_t field_count = tuple != NULL ?
+				       box_tuple_field_count(tuple) : 0;
+		for (uint32_t idx = 0; idx < bind_count; ++idx) {
+			struct ora_bind *bind = conn->binds + idx;
+			struct ora_bind_value *value = bind->values + iter;
+			bool ok;
+			if (tuple != NULL && by_name) {
+				ok = false;
+			} else if (tuple != NULL) {
+				ok = ora_array_value_mp(idx < field_count ?
+					box_tuple_field(tuple, idx) : NULL, value);
+			} else {
+				if (by_name) {
+					lua_pushlstring(L, bind->bind_name,
+							bind->bind_name_len);
+					lua_rawget(L, -2);
+				} else {
+					lua_rawgeti(L, -1, bind->pos);
+				}
+				ok = ora_array_value_lua(L, -1, value);
+				lua_pop(L, 1);
+			}
+			if (!ok || !ora_merge_type(bind, value->type)) {
+				lua_pop(L, 1);
+				snprintf(conn->message, sizeof(conn->message),
+					 "unsupported value in row %u parameter %u",
+					 iter + 1, idx + 1);
+				return -1;
+			}
+		}
+		lua_pop(L, 1);
+	}
+
+	for (uint32_t idx = 0; idx < bind_count; ++idx) {
+		if (ora_convert_values(conn, conn->binds + idx))
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * Input values of an array bind are taken from the iteration slot
+ */
+static void
+ora_bind_array_input(struct ora_bind *bind, ub4 iter, void **bufpp,
+		     ub4 *alenp, void **indp) {
+	struct ora_bind_value *value = bind->values + iter;
+	switch (bind->type) {
+	case SQLT_AFC:
+	case SQLT_BIN:
+		*bufpp = (void *)value->string.value;
+		*alenp = value->string.len;
+		break;
+	case SQLT_VNU:
+		*bufpp = &value->number;
+		*alenp = sizeof(value->number);
+		break;
+	default:
+		*bufpp = &value->int64;
+		*alenp = sizeof(value->int64);
+		break;
+	}
+	*indp = &value->ind;
+}
+
 sb4
 ora_bind_input(void *ictxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufpp,
                ub4 *alenp, ub1 *piecep, void **indp) {
 	(void) bindp;
 	struct ora_bind *bind = (struct ora_bind *)ictxp;
 	struct ora_conn_ctx *conn = bind->conn;
-	(void) iter;
 	(void) index;
+	if (bind->iters > 0) {
+		ora_bind_array_input(bind, iter, bufpp, alenp, indp);
+		*piecep = OCI_ONE_PIECE;
+		return OCI_CONTINUE;
+	}
 	switch (bind->type) {
 	case SQLT_AFC:
-		*bufpp = bind->string.value;
+	case SQLT_BIN:
+		*bufpp = (void *)bind->string.value;
 		*alenp = bind->string.len;
 		break;
 	case SQLT_VNU:
@@ -189,6 +877,10 @@ ora_bind_input(void *ictxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufpp,
 		*bufpp = &bind->uint64;
 		*alenp = sizeof(bind->uint64);
 		break;
+	case SQLT_INT:
+		*bufpp = &bind->int64;
+		*alenp = sizeof(bind->int64);
+		break;
 	default:
 		snprintf(conn->message, sizeof(conn->message),
 			 "UNREACHABLE: invalid BIND type %d\n", bind->type);
@@ -207,36 +899,26 @@ ora_bind_output(void *octxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufp,
 	struct ora_conn_ctx *conn = bind->conn;
 	(void) iter;
 
-	static ub4 rows = 0;
-        if (index == 0) {
+	if (index == 0) {
+		ub4 rows = 0;
 		(void) OCIAttrGet(bindp, OCI_HTYPE_BIND, (void *)&rows,
-				  (ub4 *)sizeof(ub4), OCI_ATTR_ROWS_RETURNED,
+				  (ub4 *)0, OCI_ATTR_ROWS_RETURNED,
 				  bind->conn->errhp);
 		if (!rows) {
 			// In case of PLSQL assume there is only one returning value
 			rows = 1;
 		}
-		bind->returns =	(struct ora_bind_return *)malloc(sizeof(struct ora_bind_return) * rows);
-		if (bind->returns == NULL) {
-			snprintf(bind->conn->message, sizeof(bind->conn->message),
-				 "could not allocate %u bytes", bind->alen);
+		if (ora_reserve_returns(bind, rows))
 			return OCI_ERROR;
-		}
-		if (!rows) rows = 1;
 		memset(bind->returns, 0, sizeof(struct ora_bind_return) * rows);
-	        bind->rowsret = (ub2)rows;
+		bind->rowsret = rows;
 	}
 
 	bind->returns[index].rlen = bind->alen;
 	switch (bind->type) {
 	case SQLT_AFC:
-		bind->returns[index].string = (char *)malloc(bind->returns[index].rlen);
-		if (bind->returns[index].string == NULL) {
-			snprintf(bind->conn->message, sizeof(bind->conn->message),
-				 "could not allocate %u bytes", bind->returns[index].rlen);
-			return OCI_ERROR;
-		}
-		*bufp = bind->returns[index].string;
+	case SQLT_BIN:
+		*bufp = bind->strings + (size_t)bind->alen * index;
 		break;
 	case SQLT_VNU:
 		*bufp = &bind->returns[index].number;
@@ -244,6 +926,9 @@ ora_bind_output(void *octxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufp,
 	case SQLT_UIN:
 		*bufp = &bind->returns[index].uint64;
 		break;
+	case SQLT_INT:
+		*bufp = &bind->returns[index].int64;
+		break;
 	default:
 		snprintf(conn->message, sizeof(conn->message),
 			 "UNREACHABLE: invalid BIND type %d\n", bind->type);
@@ -257,46 +942,142 @@ ora_bind_output(void *octxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufp,
 	return OCI_CONTINUE;
 }
 
-int
-ora_do_binds(struct ora_conn_ctx *conn) {
-	sb4 errcode;
+/**
+ * Bind values of an array DML as arrays of iters elements. Numbers,
+ * indicators and lengths are read in place from the value slots with
+ * OCIBindArrayOfStruct, strings are copied into one buffer of alen bytes
+ * per element.
+ */
+static int
+ora_do_array_bind(struct ora_conn_ctx *conn, struct ora_bind *bind) {
+	sword errcode;
+	struct ora_bind_value *values = bind->values;
+	ub4 skip = sizeof(struct ora_bind_value);
+	ub4 value_skip = skip;
+	ub2 *alenp = NULL;
+	void *value;
+	switch (bind->type) {
+	case SQLT_AFC:
+	case SQLT_BIN:
+		if (ora_reserve_strings(bind, (size_t)bind->alen * bind->iters))
+			return -1;
+		for (ub4 iter = 0; iter < bind->iters; ++iter) {
+			struct ora_bind_value *elem = values + iter;
+			elem->len = elem->ind == 0 ? (ub2)elem->string.len : 0;
+			if (elem->len > 0)
+				memcpy(bind->strings + (size_t)bind->alen * iter,
+				       elem->string.value, elem->len);
+		}
+		value = bind->strings;
+		value_skip = bind->alen;
+		alenp = &values->len;
+		break;
+	case SQLT_VNU:
+		value = &values->number;
+		break;
+	default:
+		value = &values->int64;
+		break;
+	}
 
-	for (uint32_t idx = 0; idx < conn->bind_count; ++idx) {
-		struct ora_bind *bind = conn->binds + idx;
-		struct ora_conn_ctx *conn = bind->conn;
-		void *value = NULL;
-		switch (bind->type) {
-		case SQLT_AFC:
-			value = bind->string.value;
-			break;
-		case SQLT_VNU:
-			value = &bind->number;
-			break;
-		case SQLT_UIN:
-			value = &bind->uint64;
-			break;
-		default:
-			snprintf(conn->message, sizeof(conn->message),
-				 "UNREACHABLE: invalid BIND type %d\n", bind->type);
+	if (bind->bind_name != NULL)
+		errcode = OCIBindByName(conn->stmthp, &bind->bindhp, conn->errhp,
+					(text *)bind->bind_name, bind->bind_name_len,
+					value, bind->alen, bind->type,
+					&values->ind, alenp, (ub2 *)0,
+					(ub4)0, (ub4 *)0, OCI_DEFAULT);
+	else
+		errcode = OCIBindByPos(conn->stmthp, &bind->bindhp, conn->errhp,
+				       bind->pos,
+				       value, bind->alen, bind->type,
+				       &values->ind, alenp, (ub2 *)0,
+				       (ub4)0, (ub4 *)0, OCI_DEFAULT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+
+	errcode = OCIBindArrayOfStruct(bind->bindhp, conn->errhp, value_skip,
+				       skip, alenp != NULL ? skip : 0, 0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	return 0;
+}
+
+/**
+ * Plain input parameters are bound directly by address. Dynamic binds
+ * with callbacks are used only where values could be returned: for all
+ * parameters of PL/SQL blocks and for parameters without value of DML
+ * statements with RETURNING clause. Array binds are bound as arrays,
+ * unless their strings are too long for the ub2 lengths of an array.
+ */
+static int
+ora_do_bind(struct ora_conn_ctx *conn, struct ora_bind *bind, bool dynamic) {
+	sb4 errcode;
+	bind->dynamic = dynamic;
+	if (bind->iters > 0 && !dynamic)
+		return ora_do_array_bind(conn, bind);
+	void *value = NULL;
+	sb4 value_sz = bind->alen;
+	switch (bind->type) {
+	case SQLT_AFC:
+	case SQLT_BIN:
+		value = (void *)bind->string.value;
+		if (!dynamic)
+			value_sz = bind->string.len;
+		break;
+	case SQLT_VNU:
+		value = &bind->number;
+		break;
+	case SQLT_UIN:
+		value = &bind->uint64;
+		break;
+	case SQLT_INT:
+		value = &bind->int64;
+		break;
+	case SQLT_RSET:
+		if (bind->cursor == NULL) {
+			errcode = OCIHandleAlloc((dvoid *)conn->envhp,
+						 (dvoid **)&bind->cursor,
+						 OCI_HTYPE_STMT, (size_t)0,
+						 (dvoid **)0);
+			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+				goto fail_bind;
 		}
+		value = &bind->cursor;
+		value_sz = 0;
+		break;
+	default:
+		snprintf(conn->message, sizeof(conn->message),
+			 "UNREACHABLE: invalid BIND type %d\n", bind->type);
+	}
 
+	ub4 mode = dynamic ? OCI_DATA_AT_EXEC : OCI_DEFAULT;
+	if (bind->bind_name != NULL)
 		errcode = OCIBindByName(conn->stmthp, &bind->bindhp, conn->errhp,
 					(text *)bind->bind_name, bind->bind_name_len,
-					(ub1 *)value, bind->alen, bind->type,
+					(ub1 *)value, value_sz, bind->type,
 					&bind->ind, (ub2 *)0, (ub2 *)0,
-					(ub4)0, (ub4 *)0,
-					OCI_DATA_AT_EXEC);
-		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
-			goto fail_bind;
-		}
+					(ub4)0, (ub4 *)0, mode);
+	else
+		errcode = OCIBindByPos(conn->stmthp, &bind->bindhp, conn->errhp,
+				       bind->pos,
+				       (ub1 *)value, value_sz, bind->type,
+				       &bind->ind, (ub2 *)0, (ub2 *)0,
+				       (ub4)0, (ub4 *)0, mode);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+		goto fail_bind;
+	}
 
-		errcode = OCIBindDynamic(bind->bindhp, conn->errhp,
-					 (void *)bind, ora_bind_input,
-					 (void *)bind, ora_bind_output);
-		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
-			goto fail_bind;
-		}
+	if (!dynamic)
+		return 0;
+
+	if (bind->max_rows > 0 && ora_reserve_returns(bind, bind->max_rows))
+		goto fail_bind;
 
+	errcode = OCIBindDynamic(bind->bindhp, conn->errhp,
+				 (void *)bind, ora_bind_input,
+				 (void *)bind, ora_bind_output);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+		goto fail_bind;
 	}
 
 	return 0;
@@ -305,6 +1086,141 @@ fail_bind:
 	return -1;
 }
 
+/**
+ * Statement could return values into its binds: PL/SQL blocks and DML
+ * with RETURNING clause. Ref cursors are bound by address anyway.
+ */
+static void
+ora_bind_kind(ub2 stmt_type, const char *sql, bool *plsql, bool *returning) {
+	*plsql = ora_stmt_is_plsql(stmt_type);
+	*returning = false;
+	switch (stmt_type) {
+	case OCI_STMT_INSERT:
+	case OCI_STMT_UPDATE:
+	case OCI_STMT_DELETE:
+	case OCI_STMT_MERGE:
+		*returning = ora_sql_has_returning(sql);
+		break;
+	}
+}
+
+int
+ora_do_binds(struct ora_conn_ctx *conn, ub2 stmt_type, const char *sql) {
+	conn->stat.binds += conn->bind_count;
+	bool plsql, returning;
+	ora_bind_kind(stmt_type, sql, &plsql, &returning);
+
+	for (uint32_t idx = 0; idx < conn->bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		bool dynamic = bind->type != SQLT_RSET &&
+			       (plsql || (returning && bind->output) ||
+				(bind->iters > 0 && bind->alen > UINT16_MAX));
+		if (ora_do_bind(conn, bind, dynamic))
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Push the value of a bind by name. Names of placeholders bound NULL by
+ * ora_make_missing_binds come from the statement, they are matched without case
+ * and the optional colon as OCIBindByName does.
+ */
+static void
+ora_push_named_param(struct lua_State *L, int params_table,
+		     const struct ora_bind *bind) {
+	lua_pushlstring(L, bind->bind_name, bind->bind_name_len);
+	lua_rawget(L, params_table);
+	if (!lua_isnil(L, -1))
+		return;
+	lua_pop(L, 1);
+
+	const char *name = bind->bind_name;
+	size_t name_len = bind->bind_name_len;
+	if (name_len > 0 && name[0] == ':') {
+		++name;
+		--name_len;
+	}
+	lua_pushnil(L);
+	while (lua_next(L, params_table) != 0) {
+		size_t key_len = 0;
+		const char *key = lua_type(L, -2) == LUA_TSTRING ?
+				  lua_tolstring(L, -2, &key_len) : NULL;
+		if (key != NULL && key_len > 0 && key[0] == ':') {
+			++key;
+			--key_len;
+		}
+		if (key != NULL && key_len == name_len &&
+		    strncasecmp(key, name, name_len) == 0) {
+			lua_remove(L, -2);
+			return;
+		}
+		lua_pop(L, 1);
+	}
+	lua_pushnil(L);
+}
+
+/**
+ * Overwrite values of binds made by ora_make_binds and ora_do_binds with
+ * new parameters, for a prepared statement executed again. Parameters
+ * are looked up by the names or positions of the first execution, the
+ * names must outlive the params table of that execution. Numbers and
+ * indicators are written in place and dynamic binds read their values
+ * in callbacks, only a changed type or size and a moved string of a
+ * plain bind need OCIBindByName again.
+ */
+int
+ora_update_binds(struct lua_State *L, int params_table,
+		 struct ora_conn_ctx *conn, ub2 stmt_type, const char *sql) {
+	conn->stat.binds += conn->bind_count;
+	bool plsql, returning;
+	ora_bind_kind(stmt_type, sql, &plsql, &returning);
+
+	for (uint32_t idx = 0; idx < conn->bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		struct ora_bind prev = *bind;
+
+		if (bind->bind_name != NULL) {
+			ora_push_named_param(L, params_table, bind);
+		} else {
+			lua_rawgeti(L, params_table, bind->pos);
+		}
+		ora_make_bind(L, conn, bind);
+		lua_pop(L, 1);
+		bind->bindhp = prev.bindhp;
+		bind->bind_name = prev.bind_name;
+		bind->bind_name_len = prev.bind_name_len;
+		bind->pos = prev.pos;
+		/* the ref cursor handle is reused by the next execution */
+		if (prev.type == SQLT_RSET && bind->type == SQLT_RSET)
+			bind->cursor = prev.cursor;
+		else if (prev.type == SQLT_RSET && prev.cursor != NULL)
+			(void) OCIHandleFree((dvoid *)prev.cursor, (ub4)OCI_HTYPE_STMT);
+
+		bool dynamic = bind->type != SQLT_RSET &&
+			       (plsql || (returning && bind->output));
+		bool rebind = dynamic != prev.dynamic ||
+			      bind->type != prev.type ||
+			      bind->alen != prev.alen;
+		if (!dynamic && (bind->type == SQLT_AFC ||
+				 bind->type == SQLT_BIN) &&
+		    (bind->string.value != prev.string.value ||
+		     bind->string.len != prev.string.len))
+			rebind = true;
+		if (rebind) {
+			if (ora_do_bind(conn, bind, dynamic))
+				return -1;
+		} else {
+			bind->dynamic = dynamic;
+			if (dynamic && bind->max_rows > 0 &&
+			    ora_reserve_returns(bind, bind->max_rows))
+				return -1;
+		}
+	}
+	return 0;
+}
+
 int
 ora_push_binds(struct lua_State *L, struct ora_conn_ctx *conn)
 {
@@ -316,16 +1232,34 @@ ora_push_binds(struct lua_State *L, struct ora_conn_ctx *conn)
 	for (uint32_t idx = 0; idx < conn->bind_count; ++idx)
 	{
 		struct ora_bind *bind = conn->binds + idx;
+		if (bind->type == SQLT_RSET) {
+			++output;
+			if (bind->bind_name != NULL)
+				lua_pushlstring(L, bind->bind_name, bind->bind_name_len);
+			else
+				lua_pushinteger(L, bind->pos);
+			if (ora_fetch_result(L, conn, bind->cursor)) {
+				lua_pop(L, 2);
+				return -1;
+			}
+			lua_settable(L, lua_gettop(L) - 2);
+			continue;
+		}
 		if (bind->rowsret == 0)
 			continue;
 		++output;
-		lua_pushlstring(L, bind->bind_name, bind->bind_name_len);
+		if (bind->bind_name != NULL)
+			lua_pushlstring(L, bind->bind_name, bind->bind_name_len);
+		else
+			lua_pushinteger(L, bind->pos);
 		lua_newtable(L);
-		for (ub2 row = 0; row < bind->rowsret; ++row) {
+		for (ub4 row = 0; row < bind->rowsret; ++row) {
 			lua_pushnumber(L, row);
 			switch (bind->type) {
 			case SQLT_AFC:
-				lua_pushlstring(L, bind->returns[row].string,
+			case SQLT_BIN:
+				lua_pushlstring(L, bind->strings +
+						(size_t)bind->alen * row,
 						bind->returns[row].rlen);
 				break;
 			case SQLT_VNU:
@@ -363,6 +1297,9 @@ ora_push_binds(struct lua_State *L, struct ora_conn_ctx *conn)
 			case SQLT_UIN:
 				lua_pushinteger(L, bind->returns[row].uint64);
 				break;
+			case SQLT_INT:
+				luaL_pushint64(L, bind->returns[row].int64);
+				break;
 			}
 			lua_settable(L, lua_gettop(L) - 2);
 		}
@@ -8,12 +8,25 @@
 
 #include "types.h"
 
+void
+ora_binds_init(struct lua_State *L);
+
 void
 ora_free_binds(struct ora_conn_ctx *conn);
 
+void
+ora_destroy_binds(struct ora_conn_ctx *conn);
+
 int
 ora_make_binds(struct lua_State *L, int params_table, struct ora_conn_ctx *conn);
 
+int
+ora_make_missing_binds(struct lua_State *L, struct ora_conn_ctx *conn);
+
+int
+ora_make_array_binds(struct lua_State *L, int rows_table, ub4 count,
+		     struct ora_conn_ctx *conn);
+
 
 sb4
 ora_bind_input(void *ictxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufpp,
@@ -24,7 +37,11 @@ ora_bind_output(void *octxp, OCIBind *bindp, ub4 iter, ub4 index, void **bufp,
                 ub4 **alenpp, ub1 *piecep, void **indpp, ub2 **rcodepp);
 
 int
-ora_do_binds(struct ora_conn_ctx *conn);
+ora_do_binds(struct ora_conn_ctx *conn, ub2 stmt_type, const char *sql);
+
+int
+ora_update_binds(struct lua_State *L, int params_table,
+		 struct ora_conn_ctx *conn, ub2 stmt_type, const char *sql);
 
 int
 ora_push_binds(struct lua_State *L, struct ora_conn_ctx *conn);
@@ -0,0 +1,209 @@
+-- cache.lua (internal file)
+--
+-- Result cache of select statements. Entries are keyed by statement text
+-- and normalized parameters and hold results encoded with msgpack. Every
+-- entry has a TTL, the cache has a byte budget, least recently used
+-- entries are evicted first.
+
+local msgpack = require('msgpack')
+local clock = require('clock')
+
+local cache_mt
+
+local function cache_create(opts)
+    opts = opts or {}
+    return setmetatable({
+        budget      = opts.size or 64 * 1024 * 1024,
+        ttl         = opts.ttl or 60,
+        bytes       = 0,
+        count       = 0,
+        entries     = {},
+        tags        = {},
+        -- LRU list, head is the most recently used entry
+        head        = nil,
+        tail        = nil,
+        hits        = 0,
+        misses      = 0,
+        evictions   = 0,
+    }, cache_mt)
+end
+
+-- Parameters are normalized so that equal maps give equal keys
+-- regardless of the order of traversal.
+local function normalize(args)
+    if args == nil then
+        return {}
+    end
+    if #args > 0 then
+        return args
+    end
+    local names = {}
+    for name in pairs(args) do
+        names[#names + 1] = name
+    end
+    table.sort(names)
+    local res = {}
+    for i, name in ipairs(names) do
+        res[i] = {name, args[name]}
+    end
+    return res
+end
+
+local function cache_key(sql, args)
+    return msgpack.encode({sql, normalize(args)})
+end
+
+local function unlink(self, entry)
+    if entry.prev ~= nil then
+        entry.prev.next = entry.next
+    else
+        self.head = entry.next
+    end
+    if entry.next ~= nil then
+        entry.next.prev = entry.prev
+    else
+        self.tail = entry.prev
+    end
+    entry.prev, entry.next = nil, nil
+end
+
+local function link(self, entry)
+    entry.next = self.head
+    if self.head ~= nil then
+        self.head.prev = entry
+    end
+    self.head = entry
+    if self.tail == nil then
+        self.tail = entry
+    end
+end
+
+local function remove(self, entry)
+    unlink(self, entry)
+    self.entries[entry.key] = nil
+    self.bytes = self.bytes - entry.size
+    self.count = self.count - 1
+    for _, tag in ipairs(entry.tags) do
+        local keys = self.tags[tag]
+        if keys ~= nil then
+            keys[entry.key] = nil
+            if next(keys) == nil then
+                self.tags[tag] = nil
+            end
+        end
+    end
+end
+
+-- Get decoded result of a statement or nil if it is not cached.
+local function cache_get(self, sql, args)
+    local key = cache_key(sql, args)
+    local entry = self.entries[key]
+    if entry == nil then
+        self.misses = self.misses + 1
+        return nil
+    end
+    if entry.expires <= clock.monotonic() then
+        remove(self, entry)
+        self.misses = self.misses + 1
+        return nil
+    end
+    unlink(self, entry)
+    link(self, entry)
+    self.hits = self.hits + 1
+    return msgpack.decode(entry.data)
+end
+
+-- Store result of a statement. Options are ttl in seconds and tags,
+-- usually names of the tables the result depends on.
+local function cache_put(self, sql, args, data, opts)
+    opts = opts or {}
+    local key = cache_key(sql, args)
+    local encoded = msgpack.encode(data)
+    local size = #key + #encoded
+    local old = self.entries[key]
+    if old ~= nil then
+        remove(self, old)
+    end
+    if size > self.budget then
+        return false
+    end
+
+    local entry = {
+        key = key,
+        data = encoded,
+        size = size,
+        expires = clock.monotonic() + (opts.ttl or self.ttl),
+        tags = opts.tags or {},
+    }
+    self.entries[key] = entry
+    self.bytes = self.bytes + size
+    self.count = self.count + 1
+    link(self, entry)
+    for _, tag in ipairs(entry.tags) do
+        local keys = self.tags[tag]
+        if keys == nil then
+            keys = {}
+            self.tags[tag] = keys
+        end
+        keys[key] = true
+    end
+
+    while self.bytes > self.budget do
+        remove(self, self.tail)
+        self.evictions = self.evictions + 1
+    end
+    return true
+end
+
+local function cache_invalidate(self, sql, args)
+    local entry = self.entries[cache_key(sql, args)]
+    if entry ~= nil then
+        remove(self, entry)
+    end
+end
+
+local function cache_invalidate_tag(self, tag)
+    local keys = self.tags[tag]
+    if keys == nil then
+        return
+    end
+    for key in pairs(keys) do
+        remove(self, self.entries[key])
+    end
+end
+
+local function cache_clear(self)
+    self.entries = {}
+    self.tags = {}
+    self.head, self.tail = nil, nil
+    self.bytes, self.count = 0, 0
+end
+
+local function cache_stat(self)
+    return {
+        hits = self.hits,
+        misses = self.misses,
+        evictions = self.evictions,
+        entries = self.count,
+        bytes = self.bytes,
+        budget = self.budget,
+    }
+end
+
+cache_mt = {
+    __index = {
+        get = cache_get;
+        put = cache_put;
+        invalidate = cache_invalidate;
+        invalidate_tag = cache_invalidate_tag;
+        clear = cache_clear;
+        stat = cache_stat;
+    }
+}
+
+return {
+    create = cache_create;
+    is_cache = function(obj)
+        return getmetatable(obj) == cache_mt
+    end;
+}
@@ -5,55 +5,61 @@
 
 #include "util.h"
 
+static void
+ora_free_define_buf(struct ora_conn_ctx *conn, struct ora_define *define,
+		    struct ora_define_buf *buf)
+{
+	if (buf->value == NULL)
+		return;
+
+	if (define->dty == SQLT_BLOB || define->dty == SQLT_CLOB) {
+		OCILobLocator **lobs = (OCILobLocator **)buf->value;
+		for (ub4 row = 0; row < conn->define_rows; ++row) {
+			if (lobs[row] != NULL)
+				OCIDescriptorFree((dvoid *)lobs[row], (ub4)OCI_DTYPE_LOB);
+		}
+	}
+	if (!conn->define_arena)
+		free(buf->value);
+	buf->value = NULL;
+}
+
+/**
+ * Allocate memory of defines: on the arena of the connection for plain
+ * statements, released all at once when the statement is done, or on
+ * the heap for prepared statements which keep their defines.
+ */
+static void *
+ora_define_alloc(struct ora_conn_ctx *conn, size_t size)
+{
+	void *mem = conn->define_arena ? ora_arena_alloc(&conn->arena, size) :
+		    malloc(size);
+	if (mem == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "%s %zu %s", "could not allocate ", size, "bytes");
+	}
+	return mem;
+}
+
 void
-ora_free_defines(struct ora_conn_ctx *conn)
+ora_free_defines(struct lua_State *L, struct ora_conn_ctx *conn)
 {
 	for (ub4 col_index = 1; col_index <= conn->define_count; ++col_index) {
 		struct ora_define *define = conn->defines + col_index - 1;
+		luaL_unref(L, LUA_REGISTRYINDEX, define->name_ref);
 		if (define->defhp)
 			(void) OCIHandleFree((dvoid *)define->defhp, (ub4)OCI_HTYPE_DEFINE);
 
-		switch (define->type) {
-		case OCI_TYPECODE_VARCHAR:
-		case OCI_TYPECODE_VARCHAR2:
-			if (define->string.value != NULL)
-				free(define->string.value);
-			break;
-
-		case OCI_TYPECODE_NUMBER:
-			break;
-
-		case OCI_TYPECODE_REAL:
-		case OCI_TYPECODE_DOUBLE:
-			break;
-
-		case OCI_TYPECODE_OCTET:
-		case OCI_TYPECODE_UNSIGNED8:
-		case OCI_TYPECODE_UNSIGNED16:
-		case OCI_TYPECODE_UNSIGNED32:
-			break;
-
-		case OCI_TYPECODE_SIGNED8:
-		case OCI_TYPECODE_SIGNED16:
-		case OCI_TYPECODE_SIGNED32:
-		case OCI_TYPECODE_SMALLINT:
-		case OCI_TYPECODE_INTEGER:
-			break;
-
-		case OCI_TYPECODE_BLOB:
-			OCIDescriptorFree((dvoid *)define->blob, (ub4)OCI_DTYPE_LOB);
-			break;
-
-		case OCI_TYPECODE_CLOB:
-			OCIDescriptorFree((dvoid *)define->blob, (ub4)OCI_DTYPE_LOB);
-			break;
-
-		default:
-			if (define->string.value)
-				free(define->string.value);
-			break;
-		}
+		for (int set = 0; set < ORA_DEFINE_SETS; ++set)
+			ora_free_define_buf(conn, define, define->bufs + set);
 	}
+	if (conn->define_arena)
+		ora_arena_truncate(&conn->arena, conn->define_mark);
+	else
+		free(conn->defines);
+	conn->defines = (struct ora_define *)NULL;
+	conn->define_count = 0;
+	conn->define_lobs = false;
 }
 
 static int
@@ -83,14 +89,10 @@ ora_describe(struct ora_conn_ctx *conn)
 		}
 	}
 
-	struct ora_define *defines =
-		(struct ora_define *)malloc(sizeof(struct ora_define) * col_count);
-	if (defines == NULL) {
-		snprintf(conn->message, sizeof(conn->message), "%s %lu %s",
-			 "could not allocate ",
-			 sizeof(struct ora_define) * col_count, "bytes");
+	struct ora_define *defines = (struct ora_define *)
+		ora_define_alloc(conn, sizeof(struct ora_define) * col_count);
+	if (defines == NULL)
 		return -1;
-	}
 	memset(defines, 0, sizeof(struct ora_define) * col_count);
 
 	for (ub4 col_index = 1; col_index <= col_count; ++col_index) {
@@ -99,6 +101,7 @@ ora_describe(struct ora_conn_ctx *conn)
 		CHECK_AND_GOTO(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info, fail_describe);
 
 		struct ora_define *define = defines + col_index - 1;
+		define->name_ref = LUA_NOREF;
 
 		errcode = OCIAttrGet((void*)mypard, (ub4)OCI_DTYPE_PARAM,
 				     (void*)&define->type, (ub4 *)0,
@@ -142,72 +145,138 @@ ora_describe(struct ora_conn_ctx *conn)
 	return 0;
 
 fail_describe:
-	free(defines);
+	if (conn->define_arena)
+		ora_arena_truncate(&conn->arena, conn->define_mark);
+	else
+		free(defines);
 	return -1;
 }
 
+/**
+ * Allocate a buffer set for define_rows values of a column. The
+ * value array goes first to keep it aligned, indicators and lengths
+ * follow it.
+ */
+static int
+ora_alloc_define_buf(struct ora_conn_ctx *conn, struct ora_define *define,
+		     struct ora_define_buf *buf)
+{
+	ub4 rows = conn->define_rows;
+	size_t size = ((size_t)define->value_size + sizeof(sb2) +
+		       sizeof(ub2)) * rows;
+	char *mem = (char *)ora_define_alloc(conn, size);
+	if (mem == NULL)
+		return -1;
+	memset(mem, 0, size);
+	buf->value = mem;
+	buf->ind = (sb2 *)(mem + (size_t)define->value_size * rows);
+	buf->len = (ub2 *)(buf->ind + rows);
+
+	if (define->dty != SQLT_BLOB && define->dty != SQLT_CLOB)
+		return 0;
+
+	OCILobLocator **lobs = (OCILobLocator **)buf->value;
+	for (ub4 row = 0; row < rows; ++row) {
+		sword errcode = OCIDescriptorAlloc(conn->envhp,
+						   (dvoid **)&lobs[row],
+						   (ub4)OCI_DTYPE_LOB,
+						   (size_t)0, (dvoid **)0);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+	}
+	return 0;
+}
+
 int
-ora_make_defines(struct ora_conn_ctx *conn)
+ora_define_set(struct ora_conn_ctx *conn, int set)
 {
 	sword errcode;
 
+	for (ub4 col_index = 1; col_index <= conn->define_count; ++col_index) {
+		struct ora_define *define = conn->defines + col_index - 1;
+		struct ora_define_buf *buf = define->bufs + set;
+		bool lob = define->dty == SQLT_BLOB || define->dty == SQLT_CLOB;
+
+		errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
+					 conn->errhp, col_index,
+					 (dvoid *)buf->value,
+					 lob ? (sb4)0 : (sb4)define->value_size,
+					 define->dty,
+					 (dvoid *)buf->ind, buf->len,
+					 (ub2 *)0, OCI_DEFAULT);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+	}
+	conn->define_set = set;
+
+	return 0;
+}
+
+/**
+ * Describe the select list and define buffers for it. Defines of plain
+ * statements and cursors are allocated on the arena of the connection,
+ * the ones of prepared statements which outlive them on the heap.
+ */
+int
+ora_make_defines(struct lua_State *L, struct ora_conn_ctx *conn, ub4 rows,
+		 int sets, bool arena)
+{
+	conn->define_arena = arena;
+	conn->define_mark = ora_arena_used(&conn->arena);
 	if (ora_describe(conn))
 		return -1;
 
+	conn->define_rows = rows;
+	conn->define_sets = sets;
+	conn->define_lobs = false;
+	conn->fetch_eof = false;
+
 	for (ub4 col_index = 1; col_index <= conn->define_count; ++col_index) {
 		struct ora_define *define = conn->defines + col_index - 1;
 
+		/* row template: column names are interned once per statement */
+		lua_pushlstring(L, define->col_name, define->col_name_len);
+		define->name_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
 		switch (define->type) {
 		case OCI_TYPECODE_VARCHAR:
 		case OCI_TYPECODE_VARCHAR2:
-			define->string.value = (char*)malloc(define->col_width * 4);
-			if (define->string.value == NULL) {
-				snprintf(conn->message, sizeof(conn->message),
-					 "%s %u %s", "could not allocate ",
-					 define->col_width * 4, "bytes");
-				goto fail_defines;
-			}
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)define->string.value,
-						 (sb4)define->col_width,
-						 SQLT_AFC,
-						 (dvoid *)&define->ind, (ub2 *)&define->string.len,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_AFC;
+			define->value_size = define->col_width * 4;
+			break;
+
+		/* OCI_TYPECODE_UNSIGNED8 is the same code, it is RAW here */
+		case SQLT_BIN:
+			define->dty = SQLT_BIN;
+			define->value_size = define->col_width;
+			break;
+
+		case SQLT_LBI:
+			define->dty = SQLT_LBI;
+			define->value_size = ORA_LONG_RAW_SIZE;
 			break;
 
 		case OCI_TYPECODE_NUMBER:
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->number,
-						 (sb4)sizeof(define->number),
-						 SQLT_VNU,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			if (conn->define_view) {
+				define->dty = SQLT_FLT;
+				define->value_size = sizeof(double);
+				break;
+			}
+			define->dty = SQLT_VNU;
+			define->value_size = sizeof(OCINumber);
 			break;
 
 		case OCI_TYPECODE_REAL:
 		case OCI_TYPECODE_DOUBLE:
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->int64,
-						 (sb4)sizeof(define->double64),
-						 SQLT_INT,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_FLT;
+			define->value_size = sizeof(double);
 			break;
 
 		case OCI_TYPECODE_OCTET:
-		case OCI_TYPECODE_UNSIGNED8:
 		case OCI_TYPECODE_UNSIGNED16:
 		case OCI_TYPECODE_UNSIGNED32:
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->int64,
-						 (sb4)sizeof(define->uint64),
-						 SQLT_UIN,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_UIN;
+			define->value_size = sizeof(uint64_t);
 			break;
 
 		case OCI_TYPECODE_SIGNED8:
@@ -215,72 +284,47 @@ ora_make_defines(struct ora_conn_ctx *conn)
 		case OCI_TYPECODE_SIGNED32:
 		case OCI_TYPECODE_SMALLINT:
 		case OCI_TYPECODE_INTEGER:
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->int64,
-						 (sb4)sizeof(define->int64),
-						 SQLT_INT,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_INT;
+			define->value_size = sizeof(int64_t);
 			break;
 
 		case OCI_TYPECODE_BLOB:
-			errcode = OCIDescriptorAlloc(conn->envhp, (dvoid **)&define->blob,
-						     (ub4)OCI_DTYPE_LOB, (size_t)0,
-						     (dvoid **)0);
-
-			CHECK_AND_GOTO(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info, fail_defines);
-
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->blob,
-						 (sb4)0,
-						 SQLT_BLOB,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_BLOB;
+			define->value_size = sizeof(OCILobLocator *);
+			conn->define_lobs = true;
 			break;
 
 		case OCI_TYPECODE_CLOB:
-			errcode = OCIDescriptorAlloc(conn->envhp, (dvoid **)&define->clob,
-						     (ub4)OCI_DTYPE_LOB, (size_t)0,
-						     (dvoid **)0);
-
-			CHECK_AND_GOTO(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info, fail_defines);
-
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)&define->clob,
-						 (sb4)0,
-						 SQLT_CLOB,
-						 (dvoid *)&define->ind, (ub2 *)0,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_CLOB;
+			define->value_size = sizeof(OCILobLocator *);
+			conn->define_lobs = true;
 			break;
 
 		default:
-			define->string.value = (char*)malloc(define->col_width * 4);
-			if (define->string.value == NULL) {
-				snprintf(conn->message, sizeof(conn->message),
-					 "%s %u %s", "could not allocate ",
-					 define->col_width * 4, "bytes");
-				goto fail_defines;
-			}
-			errcode = OCIDefineByPos(conn->stmthp, &define->defhp,
-						 conn->errhp, col_index,
-						 (dvoid *)define->string.value,
-						 (sb4)define->col_width,
-						 SQLT_AFC,
-						 (dvoid *)&define->ind, (ub2 *)&define->string.len,
-						 (ub2 *)0, OCI_DEFAULT);
+			define->dty = SQLT_AFC;
+			define->value_size = define->col_width * 4;
 			break;
 		}
-		CHECK_AND_GOTO(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info, fail_defines);
 
+		if (conn->define_view && conn->define_lobs) {
+			snprintf(conn->message, sizeof(conn->message), "%s",
+				 "LOB columns could not be read through a view");
+			goto fail_defines;
+		}
+
+		for (int set = 0; set < sets; ++set) {
+			if (ora_alloc_define_buf(conn, define, define->bufs + set))
+				goto fail_defines;
+		}
 	}
 
+	if (ora_define_set(conn, 0))
+		goto fail_defines;
+
 	return 0;
 
 fail_defines:
-	ora_free_defines(conn);
+	ora_free_defines(L, conn);
 
 	return -1;
 }
@@ -1,12 +1,19 @@
 #ifndef ORA_DEFINE_H
 #define ORA_DEFINE_H
 
+#include <lua.h>
+#include <lauxlib.h>
+
 #include "types.h"
 
 void
-ora_free_defines(struct ora_conn_ctx *conn);
+ora_free_defines(struct lua_State *L, struct ora_conn_ctx *conn);
+
+int
+ora_make_defines(struct lua_State *L, struct ora_conn_ctx *conn, ub4 rows,
+		 int sets, bool arena);
 
 int
-ora_make_defines(struct ora_conn_ctx *conn);
+ora_define_set(struct ora_conn_ctx *conn, int set);
 
 #endif
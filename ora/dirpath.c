@@ -0,0 +1,444 @@
+#include "dirpath.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef PACKAGE_VERSION
+#include <module.h>
+#include <msgpuck.h>
+
+#include "types.h"
+#include "async.h"
+#include "util.h"
+
+static uint32_t CTID_INT64;
+static uint32_t CTID_UINT64;
+
+void
+ora_dirpath_init(struct lua_State *L)
+{
+	CTID_INT64 = luaL_ctypeid(L, "int64_t");
+	CTID_UINT64 = luaL_ctypeid(L, "uint64_t");
+}
+
+void
+ora_dirpath_free(struct ora_conn_ctx *conn, bool abort)
+{
+	struct ora_dirpath *dp = conn->dirpath;
+	if (dp == NULL)
+		return;
+	if (abort && dp->prepared)
+		(void) OCIDirPathAbort(dp->ctx, conn->errhp);
+	/* column array and stream are freed along with their parent */
+	if (dp->ctx != NULL)
+		(void) OCIHandleFree((dvoid *)dp->ctx, (ub4)OCI_HTYPE_DIRPATH_CTX);
+	free(dp->scratch);
+	free(dp);
+	conn->dirpath = NULL;
+}
+
+/**
+ * Set name and external type of the column at position pos, the
+ * column description on top of the stack is either a name or a
+ * table with name and size fields.
+ */
+static int
+ora_dirpath_column(struct lua_State *L, struct ora_conn_ctx *conn,
+		   OCIParam *col_list, ub4 pos)
+{
+	size_t name_len = 0;
+	const char *name = NULL;
+	ub4 size = ORA_DIRPATH_COL_SIZE;
+
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "size");
+		if (lua_isnumber(L, -1))
+			size = (ub4)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		lua_getfield(L, -1, "name");
+		name = lua_tolstring(L, -1, &name_len);
+		lua_pop(L, 1);
+	} else if (lua_type(L, -1) == LUA_TSTRING) {
+		name = lua_tolstring(L, -1, &name_len);
+	}
+	if (name == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "invalid description of column %u", pos);
+		return -1;
+	}
+
+	OCIParam *col;
+	ub2 dty = SQLT_CHR;
+	sword errcode = OCIParamGet(col_list, OCI_DTYPE_PARAM, conn->errhp,
+				    (void **)&col, pos);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+
+	errcode = OCIAttrSet(col, OCI_DTYPE_PARAM, (void *)name, (ub4)name_len,
+			     OCI_ATTR_NAME, conn->errhp);
+	if (errcode == OCI_SUCCESS)
+		errcode = OCIAttrSet(col, OCI_DTYPE_PARAM, &dty, 0,
+				     OCI_ATTR_DATA_TYPE, conn->errhp);
+	if (errcode == OCI_SUCCESS)
+		errcode = OCIAttrSet(col, OCI_DTYPE_PARAM, &size, 0,
+				     OCI_ATTR_DATA_SIZE, conn->errhp);
+	(void) OCIDescriptorFree(col, OCI_DTYPE_PARAM);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	return 0;
+}
+
+/**
+ * Prepare direct path load into a table, the name may be qualified
+ * with a schema. Returns 0 on success, the context is kept by the
+ * connection until finish or abort.
+ */
+int
+ora_dirpath_open(struct lua_State *L, struct ora_conn_ctx *conn,
+		 int table_idx, int columns_idx, ub4 rows,
+		 const char *date_format)
+{
+	if (conn->dirpath != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a direct path load in progress");
+		return -1;
+	}
+	if (conn->stmthp != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a cursor opened");
+		return -1;
+	}
+
+	size_t col_count = lua_objlen(L, columns_idx);
+	if (col_count == 0 || col_count > UINT16_MAX) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "invalid count of columns");
+		return -1;
+	}
+
+	struct ora_dirpath *dp = calloc(1, sizeof(*dp));
+	if (dp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "could not allocate direct path context");
+		return -1;
+	}
+	conn->dirpath = dp;
+	dp->col_count = (ub2)col_count;
+
+	sword errcode;
+	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&dp->ctx,
+				 OCI_HTYPE_DIRPATH_CTX, (size_t)0, (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	size_t name_len;
+	const char *name = lua_tolstring(L, table_idx, &name_len);
+	const char *dot = memchr(name, '.', name_len);
+	if (dot != NULL) {
+		errcode = OCIAttrSet(dp->ctx, OCI_HTYPE_DIRPATH_CTX,
+				     (void *)name, (ub4)(dot - name),
+				     OCI_ATTR_SCHEMA_NAME, conn->errhp);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			goto fail;
+		name_len -= dot - name + 1;
+		name = dot + 1;
+	}
+	errcode = OCIAttrSet(dp->ctx, OCI_HTYPE_DIRPATH_CTX, (void *)name,
+			     (ub4)name_len, OCI_ATTR_NAME, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	if (date_format != NULL) {
+		errcode = OCIAttrSet(dp->ctx, OCI_HTYPE_DIRPATH_CTX,
+				     (void *)date_format,
+				     (ub4)strlen(date_format),
+				     OCI_ATTR_DATEFORMAT, conn->errhp);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			goto fail;
+	}
+
+	errcode = OCIAttrSet(dp->ctx, OCI_HTYPE_DIRPATH_CTX, &dp->col_count, 0,
+			     OCI_ATTR_NUM_COLS, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+	errcode = OCIAttrSet(dp->ctx, OCI_HTYPE_DIRPATH_CTX, &rows, 0,
+			     OCI_ATTR_NUM_ROWS, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	OCIParam *col_list;
+	errcode = OCIAttrGet(dp->ctx, OCI_HTYPE_DIRPATH_CTX, &col_list, NULL,
+			     OCI_ATTR_LIST_COLUMNS, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	for (ub4 pos = 1; pos <= dp->col_count; ++pos) {
+		lua_rawgeti(L, columns_idx, pos);
+		int rc = ora_dirpath_column(L, conn, col_list, pos);
+		lua_pop(L, 1);
+		if (rc)
+			goto fail;
+	}
+
+	errcode = oci_dirpath_prepare_coio(&conn->stat, dp->ctx, conn->svchp,
+					   conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+	dp->prepared = true;
+
+	errcode = OCIHandleAlloc((dvoid *)dp->ctx, (dvoid **)&dp->colarr,
+				 OCI_HTYPE_DIRPATH_COLUMN_ARRAY, (size_t)0,
+				 (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+	errcode = OCIHandleAlloc((dvoid *)dp->ctx, (dvoid **)&dp->stream,
+				 OCI_HTYPE_DIRPATH_STREAM, (size_t)0,
+				 (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	/* the column array may hold less rows than requested */
+	errcode = OCIAttrGet(dp->colarr, OCI_HTYPE_DIRPATH_COLUMN_ARRAY,
+			     &dp->rows, NULL, OCI_ATTR_NUM_ROWS, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+
+	dp->scratch = malloc((size_t)dp->rows * dp->col_count *
+			     ORA_DIRPATH_NUM_SIZE);
+	if (dp->scratch == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "could not allocate direct path buffer");
+		goto fail;
+	}
+	return 0;
+
+fail:
+	ora_dirpath_free(conn, true);
+	return -1;
+}
+
+/**
+ * Format a number as text for the column array.
+ */
+static int
+ora_dirpath_number(double number, char *scratch, const char **value,
+		   ub4 *len)
+{
+	if (!isfinite(number))
+		return -1;
+	int n;
+	if (number == floor(number) && number >= -9.2e18 && number <= 9.2e18)
+		n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%" PRId64,
+			     (int64_t)number);
+	else
+		n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%.17g", number);
+	*value = scratch;
+	*len = (ub4)n;
+	return 0;
+}
+
+/**
+ * Get text of a lua value. Returns 1 for NULL, -1 for a value which
+ * could not be loaded.
+ */
+static int
+ora_dirpath_lua_value(struct lua_State *L, int idx, char *scratch,
+		      const char **value, ub4 *len)
+{
+	size_t size;
+	if (luaL_iscdata(L, idx)) {
+		uint32_t ctypeid;
+		void *data = luaL_checkcdata(L, idx, &ctypeid);
+		int n;
+		if (ctypeid == CTID_INT64)
+			n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%" PRId64,
+				     *(int64_t *)data);
+		else if (ctypeid == CTID_UINT64)
+			n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%" PRIu64,
+				     *(uint64_t *)data);
+		else if (*(void **)data == NULL)
+			return 1; /* box.NULL */
+		else
+			return -1;
+		*value = scratch;
+		*len = (ub4)n;
+		return 0;
+	}
+	switch (lua_type(L, idx)) {
+	case LUA_TNIL:
+		return 1;
+	case LUA_TSTRING:
+		*value = lua_tolstring(L, idx, &size);
+		*len = (ub4)size;
+		return 0;
+	case LUA_TNUMBER:
+		return ora_dirpath_number(lua_tonumber(L, idx), scratch,
+					  value, len);
+	case LUA_TBOOLEAN:
+		*value = lua_toboolean(L, idx) ? "1" : "0";
+		*len = 1;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Get text of a msgpack encoded tuple field.
+ */
+static int
+ora_dirpath_mp_value(const char *field, char *scratch, const char **value,
+		     ub4 *len)
+{
+	uint32_t size;
+	int n;
+	if (field == NULL)
+		return 1;
+	switch (mp_typeof(*field)) {
+	case MP_NIL:
+		return 1;
+	case MP_STR:
+		*value = mp_decode_str(&field, &size);
+		*len = size;
+		return 0;
+	case MP_BIN:
+		*value = mp_decode_bin(&field, &size);
+		*len = size;
+		return 0;
+	case MP_UINT:
+		n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%" PRIu64,
+			     mp_decode_uint(&field));
+		break;
+	case MP_INT:
+		n = snprintf(scratch, ORA_DIRPATH_NUM_SIZE, "%" PRId64,
+			     mp_decode_int(&field));
+		break;
+	case MP_FLOAT:
+		return ora_dirpath_number(mp_decode_float(&field), scratch,
+					  value, len);
+	case MP_DOUBLE:
+		return ora_dirpath_number(mp_decode_double(&field), scratch,
+					  value, len);
+	case MP_BOOL:
+		*value = mp_decode_bool(&field) ? "1" : "0";
+		*len = 1;
+		return 0;
+	default:
+		return -1;
+	}
+	*value = scratch;
+	*len = (ub4)n;
+	return 0;
+}
+
+/**
+ * Fill the column array with count rows of the lua table at rows_idx
+ * and load them. A row is either a lua array or a tuple holding values
+ * in column order. Strings are passed without copying, the rows table
+ * keeps them alive until the load is done.
+ */
+int
+ora_dirpath_load(struct lua_State *L, struct ora_conn_ctx *conn,
+		 int rows_idx, ub4 count)
+{
+	struct ora_dirpath *dp = conn->dirpath;
+	if (dp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is no direct path load in progress");
+		return -1;
+	}
+	if (count > dp->rows) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "chunk of %u rows exceeds the column array of %u",
+			 count, dp->rows);
+		return -1;
+	}
+
+	sword errcode = OCIDirPathColArrayReset(dp->colarr, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+
+	for (ub4 row = 0; row < count; ++row) {
+		lua_rawgeti(L, rows_idx, row + 1);
+		box_tuple_t *tuple = luaT_istuple(L, -1);
+		if (tuple == NULL && !lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			snprintf(conn->message, sizeof(conn->message),
+				 "row %u is neither a table nor a tuple",
+				 row + 1);
+			return -1;
+		}
+		uint32_t field_count = tuple != NULL ?
+				       box_tuple_field_count(tuple) : 0;
+
+		for (ub2 col = 0; col < dp->col_count; ++col) {
+			char *scratch = dp->scratch +
+				((size_t)row * dp->col_count + col) *
+				ORA_DIRPATH_NUM_SIZE;
+			const char *value = NULL;
+			ub4 len = 0;
+			int rc;
+			if (tuple != NULL) {
+				const char *field = col < field_count ?
+					box_tuple_field(tuple, col) : NULL;
+				rc = ora_dirpath_mp_value(field, scratch,
+							  &value, &len);
+			} else {
+				lua_rawgeti(L, -1, col + 1);
+				rc = ora_dirpath_lua_value(L, -1, scratch,
+							   &value, &len);
+				lua_pop(L, 1);
+			}
+			if (rc < 0) {
+				lua_pop(L, 1);
+				snprintf(conn->message, sizeof(conn->message),
+					 "unsupported value in row %u column %u",
+					 row + 1, col + 1);
+				return -1;
+			}
+			errcode = OCIDirPathColArrayEntrySet(dp->colarr,
+				conn->errhp, row, col, (ub1 *)value, len,
+				rc ? OCI_DIRPATH_COL_NULL :
+				     OCI_DIRPATH_COL_COMPLETE);
+			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+				lua_pop(L, 1);
+				return -1;
+			}
+		}
+		lua_pop(L, 1);
+	}
+
+	if (count == 0)
+		return 0;
+
+	errcode = oci_dirpath_load_coio(&conn->stat, dp->ctx, dp->colarr,
+					dp->stream, conn->errhp, count);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	return (int)count;
+}
+
+/**
+ * Commit loaded data and free the context.
+ */
+int
+ora_dirpath_finish(struct ora_conn_ctx *conn)
+{
+	struct ora_dirpath *dp = conn->dirpath;
+	if (dp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is no direct path load in progress");
+		return -1;
+	}
+
+	sword errcode = oci_dirpath_finish_coio(&conn->stat, dp->ctx, conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+		ora_dirpath_free(conn, true);
+		return -1;
+	}
+	ora_dirpath_free(conn, false);
+	return 0;
+}
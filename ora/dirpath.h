@@ -0,0 +1,36 @@
+#ifndef ORA_DIRPATH_H
+#define ORA_DIRPATH_H
+
+#include <stdbool.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include <oci.h>
+
+#include "types.h"
+
+/* default external size of a column value */
+#define ORA_DIRPATH_COL_SIZE 4000
+/* room for a number formatted as text */
+#define ORA_DIRPATH_NUM_SIZE 32
+
+void
+ora_dirpath_init(struct lua_State *L);
+
+int
+ora_dirpath_open(struct lua_State *L, struct ora_conn_ctx *conn,
+		 int table_idx, int columns_idx, ub4 rows,
+		 const char *date_format);
+
+int
+ora_dirpath_load(struct lua_State *L, struct ora_conn_ctx *conn,
+		 int rows_idx, ub4 count);
+
+int
+ora_dirpath_finish(struct ora_conn_ctx *conn);
+
+void
+ora_dirpath_free(struct ora_conn_ctx *conn, bool abort);
+
+#endif
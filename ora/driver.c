@@ -46,6 +46,10 @@
 #include "util.h"
 #include "define.h"
 #include "fetch.h"
+#include "dirpath.h"
+#include "stmt.h"
+#include "batch.h"
+#include "export.h"
 
 static const char ora_driver_label[] = "__tnt_ora_driver";
 
@@ -71,18 +75,37 @@ lua_push_error(struct lua_State *L)
 }
 
 /**
- * Start query execution
+ * Statements could not run on the service context while a cursor is
+ * opened or a direct path load is in progress, the message is set then
+ */
+static bool
+ora_conn_busy(struct ora_conn_ctx *conn)
+{
+	if (conn->stmthp != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a cursor opened");
+		return true;
+	}
+	if (conn->dirpath != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a direct path load in progress");
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Start query execution. A true autocommit argument commits a non-select
+ * statement in the same round trip.
  */
 static int
 lua_ora_execute(struct lua_State *L)
 {
 	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	ora_stmt_free_pending(L, conn);
 
-	if (conn->stmthp != NULL) {
-		snprintf(conn->message, sizeof(conn->message), "%s",
-			 "there is a cursor opened");
+	if (ora_conn_busy(conn))
 		goto fail_stmt;
-	}
 
 	conn->info = false;
 
@@ -92,6 +115,9 @@ lua_ora_execute(struct lua_State *L)
 	}
 	const char *sql = lua_tostring(L, 2);
 
+	memset(&conn->timing, 0, sizeof(conn->timing));
+	double phase = clock_monotonic();
+
 	sword errcode;
 	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&conn->stmthp,
 				 OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
@@ -103,13 +129,12 @@ lua_ora_execute(struct lua_State *L)
 				(ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
 	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 		goto fail_prepare;
+	conn->timing.prepare = clock_monotonic() - phase;
+	phase = clock_monotonic();
 
 	if (ora_make_binds(L, 3, conn))
 		goto fail_make_binds;
 
-	if (ora_do_binds(conn))
-		goto fail_bind;
-
 	ub2 stmt_type;
 	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&stmt_type,
 			     (ub4 *)0, (ub4)OCI_ATTR_STMT_TYPE,
@@ -118,6 +143,11 @@ lua_ora_execute(struct lua_State *L)
 		goto fail_execute;
 	}
 
+	if (ora_do_binds(conn, stmt_type, sql))
+		goto fail_bind;
+	conn->timing.bind = clock_monotonic() - phase;
+	conn->timing.binds = conn->bind_count;
+
 	int result;
 	ub4 exec_count;
 	switch (stmt_type) {
@@ -129,8 +159,13 @@ lua_ora_execute(struct lua_State *L)
 		break;
 	}
 
-	errcode = oci_stmt_execute_coio(conn->svchp, conn->stmthp, conn->errhp,
-					exec_count);
+	ub4 mode = exec_count > 0 && lua_toboolean(L, 4) ?
+		   OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT;
+	++conn->stat.executes;
+	phase = clock_monotonic();
+	errcode = oci_stmt_execute_coio(&conn->stat, conn->svchp, conn->stmthp,
+					conn->errhp, exec_count, mode);
+	conn->timing.execute = clock_monotonic() - phase;
 
 	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
 		goto fail_execute;
@@ -148,22 +183,35 @@ lua_ora_execute(struct lua_State *L)
 	}
 
 	if (exec_count == 0) {
-		if (ora_make_defines(conn))
+		conn->define_view = false;
+		phase = clock_monotonic();
+		if (ora_make_defines(L, conn, 1, 1, true))
 			goto fail_defines;
+		conn->timing.define = clock_monotonic() - phase;
 
 		if (ora_fetch_and_push_all(L, conn)) {
-			ora_free_defines(conn);
+			ora_free_defines(L, conn);
 			goto fail_fetch;
 		}
+		ora_free_defines(L, conn);
 
 		++result;
 	} else {
-		lua_pushnil(L);
+		int implicit = 0;
+		if (ora_stmt_is_plsql(stmt_type))
+			implicit = ora_fetch_implicit_results(L, conn);
+		if (implicit < 0)
+			goto fail_fetch;
+		if (implicit == 0)
+			lua_pushnil(L);
 
 		++result;
 	}
 
-	if (ora_push_binds(L, conn) > 0)
+	int output = ora_push_binds(L, conn);
+	if (output < 0)
+		goto fail_fetch;
+	if (output > 0)
 		++result;
 
 	ora_free_binds(conn);
@@ -195,17 +243,134 @@ fail_stmt:
 }
 
 /**
- * Open cursor
+ * Execute a DML statement once per row of parameters in a single round
+ * trip, committing it there with a true autocommit argument. Returns
+ * count of processed rows.
  */
 static int
-lua_ora_cursor_open(struct lua_State *L)
+lua_ora_execute_array(struct lua_State *L)
 {
 	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
-	if (conn->stmthp != NULL) {
-		snprintf(conn->message, sizeof(conn->message), "%s",
-			 "there is a cursor opened");
+	ora_stmt_free_pending(L, conn);
+
+	if (ora_conn_busy(conn))
+		goto fail_stmt;
+
+	conn->info = false;
+
+	if (!lua_isstring(L, 2) || !lua_istable(L, 3)) {
+		safe_pushstring(L, "Usage: execute_array(sql, rows, count, autocommit)");
+		return lua_push_error(L);
+	}
+	const char *sql = lua_tostring(L, 2);
+	lua_Integer count = lua_isnumber(L, 4) ? lua_tointeger(L, 4) :
+			    (lua_Integer)lua_objlen(L, 3);
+	if (count <= 0) {
+		lua_pushnumber(L, 0);
+		lua_pushnil(L);
+		lua_pushinteger(L, 0);
+		return 3;
+	}
+
+	memset(&conn->timing, 0, sizeof(conn->timing));
+	double phase = clock_monotonic();
+
+	sword errcode;
+	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&conn->stmthp,
+				 OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 		goto fail_stmt;
+
+	errcode = OCIStmtPrepare(conn->stmthp, conn->errhp, (text *)sql,
+				(ub4)strlen(sql),
+				(ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_prepare;
+	conn->timing.prepare = clock_monotonic() - phase;
+	phase = clock_monotonic();
+
+	ub2 stmt_type;
+	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&stmt_type,
+			     (ub4 *)0, (ub4)OCI_ATTR_STMT_TYPE,
+			     (OCIError *)conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_prepare;
+
+	if (stmt_type == OCI_STMT_SELECT) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "invalid statement type");
+		goto fail_prepare;
+	}
+
+	if (ora_make_array_binds(L, 3, (ub4)count, conn))
+		goto fail_bind;
+
+	if (ora_do_binds(conn, stmt_type, sql))
+		goto fail_bind;
+	conn->timing.bind = clock_monotonic() - phase;
+	conn->timing.binds = conn->bind_count;
+
+	++conn->stat.executes;
+	phase = clock_monotonic();
+	errcode = oci_stmt_execute_coio(&conn->stat, conn->svchp, conn->stmthp,
+					conn->errhp, (ub4)count,
+					lua_toboolean(L, 5) ?
+					OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT);
+	conn->timing.execute = clock_monotonic() - phase;
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_bind;
+
+	ub4 row_count = 0;
+	(void) OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&row_count,
+			  (ub4 *)0, (ub4)OCI_ATTR_ROW_COUNT, conn->errhp);
+
+	ora_free_binds(conn);
+	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
+	conn->stmthp = NULL;
+
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_pushinteger(L, row_count);
+	return 3;
+
+fail_bind:
+	ora_free_binds(conn);
+
+fail_prepare:
+	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
+	conn->stmthp = NULL;
+
+fail_stmt:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Open cursor. If the optional batch size is passed then two define
+ * buffer sets of that many rows are allocated for read-ahead fetching,
+ * or the optional count of sets. The optional view flag prepares the
+ * buffers to be read through FFI.
+ */
+static int
+lua_ora_cursor_open(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	ora_stmt_free_pending(L, conn);
+	ub4 batch = 1;
+	int sets = 1;
+	if (!lua_isnoneornil(L, 4)) {
+		lua_Integer rows = lua_tointeger(L, 4);
+		batch = rows > 0 ? (ub4)rows : 1;
+		sets = ORA_DEFINE_SETS;
+		if (!lua_isnoneornil(L, 6) && lua_tointeger(L, 6) == 1)
+			sets = 1;
 	}
+	if (ora_conn_busy(conn))
+		goto fail_stmt;
 
 	if (!lua_isstring(L, 2)) {
 		safe_pushstring(L, "Second param should be a sql command");
@@ -216,6 +381,9 @@ lua_ora_cursor_open(struct lua_State *L)
 
 	const char *sql = lua_tostring(L, 2);
 
+	memset(&conn->timing, 0, sizeof(conn->timing));
+	double phase = clock_monotonic();
+
 	sword errcode;
 	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&conn->stmthp,
 				 OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
@@ -227,13 +395,12 @@ lua_ora_cursor_open(struct lua_State *L)
 				(ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
 	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 		goto fail_prepare;
+	conn->timing.prepare = clock_monotonic() - phase;
+	phase = clock_monotonic();
 
 	if (ora_make_binds(L, 3, conn))
 		goto fail_make_binds;
 
-	if (ora_do_binds(conn))
-		goto fail_bind;
-
 	ub2 stmt_type;
 	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&stmt_type,
 			     (ub4 *)0, (ub4)OCI_ATTR_STMT_TYPE,
@@ -242,16 +409,22 @@ lua_ora_cursor_open(struct lua_State *L)
 		goto fail_execute;
 	}
 
+	if (ora_do_binds(conn, stmt_type, sql))
+		goto fail_bind;
+	conn->timing.bind = clock_monotonic() - phase;
+	conn->timing.binds = conn->bind_count;
+
 	if (stmt_type != OCI_STMT_SELECT) {
 		snprintf(conn->message, sizeof(conn->message), "%s",
 			 "invalid statement type");
 		goto fail_execute;
 	}
 
-	errcode = OCIStmtExecute(conn->svchp, conn->stmthp, conn->errhp,
-				 (ub4)0,
-				 (ub4)0, (CONST OCISnapshot *) NULL,
-				 (OCISnapshot *) NULL, OCI_DEFAULT);
+	++conn->stat.executes;
+	phase = clock_monotonic();
+	errcode = oci_stmt_execute_coio(&conn->stat, conn->svchp, conn->stmthp,
+					conn->errhp, 0, OCI_DEFAULT);
+	conn->timing.execute = clock_monotonic() - phase;
 	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
 		goto fail_execute;
 	}
@@ -259,8 +432,11 @@ lua_ora_cursor_open(struct lua_State *L)
 	int result = 1;
 	lua_pushnumber(L, 0);
 
-	if (ora_make_defines(conn))
+	conn->define_view = lua_toboolean(L, 5);
+	phase = clock_monotonic();
+	if (ora_make_defines(L, conn, batch, sets, true))
 		goto fail_defines;
+	conn->timing.define = clock_monotonic() - phase;
 
 	ora_free_binds(conn);
 
@@ -272,10 +448,14 @@ lua_ora_cursor_open(struct lua_State *L)
 		++result;
 	}
 
+	/* LOB values are read on conversion, so no read-ahead for them */
+	lua_pushboolean(L, !conn->define_lobs);
+	++result;
+
 	return result;
 
 fail_defines:
-	ora_free_defines(conn);
+	ora_free_defines(L, conn);
 
 fail_execute:
 
@@ -313,7 +493,7 @@ lua_ora_cursor_fetch(struct lua_State *L)
 
 	int row_cnt = ora_fetch_row(conn);
 	if (row_cnt == 0) {
-		ora_free_defines(conn);
+		ora_free_defines(L, conn);
 		(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
 		conn->stmthp = NULL;
 		return 1;
@@ -327,13 +507,63 @@ lua_ora_cursor_fetch(struct lua_State *L)
 	else
 		lua_pushnil(L);
 
-	if (ora_push_row(L, conn) < 0)
+	double start = clock_monotonic();
+	if (ora_push_row(L, conn, conn->define_set, 0) < 0)
+		goto fail_fetch;
+	double convert = clock_monotonic() - start;
+	conn->stat.convert_time += convert;
+	conn->timing.convert += convert;
+
+	return 3;
+
+fail_fetch:
+	ora_free_defines(L, conn);
+	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
+	conn->stmthp = NULL;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Fetch next batch from cursor into the given define buffer set.
+ * Buffers are kept on eof, the cursor should be closed explicitly.
+ */
+static int
+lua_ora_cursor_fetch_batch(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	int set = lua_tointeger(L, 2);
+
+	if (conn->stmthp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "there is no open cursor");
+		goto error;
+	}
+
+	if (set < 0 || set >= conn->define_sets) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "invalid define buffer set");
+		goto error;
+	}
+
+	conn->info = false;
+
+	int row_cnt = ora_fetch_batch(conn, set);
+	if (row_cnt < 0)
 		goto fail_fetch;
 
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_pushinteger(L, row_cnt);
+
 	return 3;
 
 fail_fetch:
-	ora_free_defines(conn);
+	ora_free_defines(L, conn);
 	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
 	conn->stmthp = NULL;
 
@@ -343,6 +573,139 @@ error:
 	return fail ? lua_push_error(L): 2;
 }
 
+/**
+ * Convert rows fetched into the given define buffer set to lua tables.
+ * Must not overlap a fetch into the other set: the environment is not
+ * OCI_THREADED, so number conversion runs under the connection guard
+ * before the read-ahead fetch is started.
+ */
+static int
+lua_ora_cursor_push_batch(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	int set = lua_tointeger(L, 2);
+	lua_Integer count = lua_tointeger(L, 3);
+
+	if (conn->stmthp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "there is no open cursor");
+		goto error;
+	}
+
+	if (set < 0 || set >= conn->define_sets || count < 0 ||
+	    (ub4)count > conn->define_rows) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "invalid define buffer set");
+		goto error;
+	}
+
+	/*
+	 * The cursor is kept on failure as the other set may still be
+	 * fetched into, it is closed by the caller.
+	 */
+	lua_pushnumber(L, 0);
+	lua_pushnil(L);
+	if (ora_push_batch(L, conn, set, (ub4)count) < 0)
+		goto error;
+
+	return 3;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Describe buffers of the given define buffer set for FFI views of a
+ * cursor opened with the view flag: an array of columns with name,
+ * external type, value size and addresses of value, indicator and
+ * length arrays.
+ */
+static int
+lua_ora_cursor_view(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	int set = lua_tointeger(L, 2);
+
+	if (conn->stmthp == NULL || !conn->define_view) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is no cursor opened for views");
+		goto error;
+	}
+
+	if (set < 0 || set >= conn->define_sets) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "invalid define buffer set");
+		goto error;
+	}
+
+	lua_pushnumber(L, 0);
+	lua_pushnil(L);
+	lua_createtable(L, conn->define_count, 0);
+	for (ub4 col_index = 0; col_index < conn->define_count; ++col_index) {
+		struct ora_define *define = conn->defines + col_index;
+		struct ora_define_buf *buf = define->bufs + set;
+		lua_createtable(L, 0, 6);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, define->name_ref);
+		lua_setfield(L, -2, "name");
+		lua_pushinteger(L, define->dty);
+		lua_setfield(L, -2, "dty");
+		lua_pushinteger(L, define->value_size);
+		lua_setfield(L, -2, "size");
+		lua_pushlightuserdata(L, buf->value);
+		lua_setfield(L, -2, "value");
+		lua_pushlightuserdata(L, buf->ind);
+		lua_setfield(L, -2, "ind");
+		lua_pushlightuserdata(L, buf->len);
+		lua_setfield(L, -2, "len");
+		lua_rawseti(L, -2, col_index + 1);
+	}
+	return 3;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Write all rows of the open cursor to a file in csv, msgpack or jsonl
+ * format. The cursor should be closed afterwards.
+ */
+static int
+lua_ora_cursor_export(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	if (conn->stmthp == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s", "there is no open cursor");
+		goto error;
+	}
+
+	if (!lua_isstring(L, 2) || !lua_isstring(L, 3)) {
+		safe_pushstring(L, "Export expects a path and a format");
+		return lua_push_error(L);
+	}
+
+	conn->info = false;
+
+	uint64_t rows = 0;
+	if (ora_export(conn, lua_tostring(L, 2), lua_tostring(L, 3), &rows))
+		goto error;
+
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_pushnumber(L, (double)rows);
+
+	return 3;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
 /**
  * Close cursor
  */
@@ -354,12 +717,464 @@ lua_ora_cursor_close(struct lua_State *L)
 	if (conn->stmthp == NULL)
 		return 0;
 
-	ora_free_defines(conn);
+	ora_free_defines(L, conn);
 	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
 	conn->stmthp = NULL;
 	return 0;
 }
 
+/**
+ * Prepare a statement for repeated execution
+ */
+static int
+lua_ora_prepare(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	ora_stmt_free_pending(L, conn);
+
+	if (!lua_isstring(L, 2)) {
+		safe_pushstring(L, "Second param should be a sql command");
+		return lua_push_error(L);
+	}
+
+	conn->info = false;
+
+	memset(&conn->timing, 0, sizeof(conn->timing));
+	double phase = clock_monotonic();
+
+	lua_pushnumber(L, 0);
+	lua_pushnil(L);
+	if (ora_stmt_prepare(L, conn, lua_tostring(L, 2))) {
+		lua_pop(L, 2);
+		lua_pushinteger(L, 1);
+		int fail = safe_pushstring(L, conn->message);
+		return fail ? lua_push_error(L): 2;
+	}
+	conn->timing.prepare = clock_monotonic() - phase;
+	return 3;
+}
+
+/**
+ * Execute a prepared statement. The first execution makes binds and
+ * defines, the next ones only overwrite bound values and reuse the
+ * define buffers. Every placeholder is bound at the first execution,
+ * the ones missing from params are NULL. Takes autocommit and returns
+ * the same as execute.
+ */
+static int
+lua_ora_stmt_execute(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	struct ora_stmt *stmt = ora_stmt_check(L, 2);
+	ora_stmt_free_pending(L, conn);
+
+	if (stmt->conn != conn) {
+		safe_pushstring(L, "Statement is prepared on another connection");
+		return lua_push_error(L);
+	}
+
+	if (ora_conn_busy(conn))
+		goto fail_stmt;
+
+	conn->info = false;
+
+	memset(&conn->timing, 0, sizeof(conn->timing));
+	ora_stmt_swap(conn, stmt);
+	double phase = clock_monotonic();
+
+	if (!stmt->bound) {
+		if (ora_make_binds(L, 3, conn))
+			goto fail_bind;
+		if (ora_make_missing_binds(L, conn))
+			goto fail_bind;
+		if (ora_stmt_keep_names(conn, stmt))
+			goto fail_bind;
+		if (ora_do_binds(conn, stmt->stmt_type, stmt->sql))
+			goto fail_bind;
+		stmt->bound = true;
+	} else if (ora_update_binds(L, 3, conn, stmt->stmt_type, stmt->sql)) {
+		goto fail_bind;
+	}
+	conn->timing.bind = clock_monotonic() - phase;
+	conn->timing.binds = conn->bind_count;
+
+	sword errcode;
+	bool select = stmt->stmt_type == OCI_STMT_SELECT;
+	++conn->stat.executes;
+	++conn->stat.prepared_executes;
+	phase = clock_monotonic();
+	ub4 mode = !select && lua_toboolean(L, 4) ?
+		   OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT;
+	errcode = oci_stmt_execute_coio(&conn->stat, conn->svchp, conn->stmthp,
+					conn->errhp, select ? 0 : 1, mode);
+	conn->timing.execute = clock_monotonic() - phase;
+
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
+		goto fail_execute;
+	}
+
+	int result = 1;
+	lua_pushnumber(L, 0);
+
+	if (conn->info)	{
+		lua_pushstring(L, conn->message);
+		++result;
+	} else {
+		lua_pushnil(L);
+		++result;
+	}
+
+	if (select) {
+		if (conn->defines == NULL) {
+			conn->define_view = false;
+			phase = clock_monotonic();
+			if (ora_make_defines(L, conn, 1, 1, false))
+				goto fail_execute;
+			conn->timing.define = clock_monotonic() - phase;
+		} else {
+			conn->fetch_eof = false;
+		}
+
+		if (ora_fetch_and_push_all(L, conn)) {
+			ora_free_defines(L, conn);
+			goto fail_execute;
+		}
+
+		++result;
+	} else {
+		int implicit = 0;
+		if (ora_stmt_is_plsql(stmt->stmt_type))
+			implicit = ora_fetch_implicit_results(L, conn);
+		if (implicit < 0)
+			goto fail_execute;
+		if (implicit == 0)
+			lua_pushnil(L);
+
+		++result;
+	}
+
+	int output = ora_push_binds(L, conn);
+	if (output < 0)
+		goto fail_execute;
+	if (output > 0)
+		++result;
+
+	ora_stmt_swap(conn, stmt);
+	return result;
+
+fail_bind:
+	ora_free_binds(conn);
+	stmt->bound = false;
+
+fail_execute:
+	ora_stmt_swap(conn, stmt);
+
+fail_stmt:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Execute a list of {sql, binds} statements in one worker thread job,
+ * optionally as a transaction. Returns an array of results.
+ */
+static int
+lua_ora_execute_batch(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	ora_stmt_free_pending(L, conn);
+
+	if (ora_conn_busy(conn))
+		goto fail;
+
+	if (!lua_istable(L, 2)) {
+		safe_pushstring(L, "Usage: execute_batch(statements, transactional)");
+		return lua_push_error(L);
+	}
+
+	conn->info = false;
+	memset(&conn->timing, 0, sizeof(conn->timing));
+
+	if (ora_batch_execute(L, conn, 2, lua_toboolean(L, 3)))
+		goto fail;
+
+	lua_pushnumber(L, 0);
+	lua_insert(L, -2);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_insert(L, -2);
+	return 3;
+
+fail:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Commit the transaction without a statement
+ */
+static int
+lua_ora_commit(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	if (conn->dirpath != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a direct path load in progress");
+		goto fail;
+	}
+
+	conn->info = false;
+	sword errcode = oci_trans_commit_coio(&conn->stat, conn->svchp,
+					      conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	return 2;
+
+fail:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Roll back the transaction without a statement
+ */
+static int
+lua_ora_rollback(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	if (conn->dirpath != NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s",
+			 "there is a direct path load in progress");
+		goto fail;
+	}
+
+	conn->info = false;
+	sword errcode = oci_trans_rollback_coio(&conn->stat, conn->svchp,
+						conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail;
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	return 2;
+
+fail:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Close a prepared statement
+ */
+static int
+lua_ora_stmt_close(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	struct ora_stmt *stmt = ora_stmt_check(L, 2);
+	ora_stmt_free_pending(L, conn);
+	if (stmt->conn == conn)
+		ora_stmt_free(L, stmt);
+	lua_pushnumber(L, 0);
+	return 1;
+}
+
+/**
+ * Prepare direct path load into a table. Accepts the table name, an
+ * array of column names or {name = ..., size = ...} tables, rows per
+ * chunk and an optional date format. Returns the actual chunk size.
+ */
+static int
+lua_ora_dirpath_open(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	if (!lua_isstring(L, 2) || !lua_istable(L, 3)) {
+		safe_pushstring(L, "Usage: dirpath_open(table, columns, rows)");
+		return lua_push_error(L);
+	}
+	lua_Integer rows = lua_tointeger(L, 4);
+	const char *date_format = lua_isstring(L, 5) ? lua_tostring(L, 5) : NULL;
+
+	conn->info = false;
+
+	if (ora_dirpath_open(L, conn, 2, 3, rows > 0 ? (ub4)rows : 1,
+			     date_format))
+		goto error;
+
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_pushinteger(L, conn->dirpath->rows);
+	return 3;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Load the first count rows of a table of rows. The load is aborted
+ * by the caller on failure.
+ */
+static int
+lua_ora_dirpath_load(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	if (!lua_istable(L, 2)) {
+		safe_pushstring(L, "Usage: dirpath_load(rows, count)");
+		return lua_push_error(L);
+	}
+	lua_Integer count = lua_isnumber(L, 3) ? lua_tointeger(L, 3) :
+			    (lua_Integer)lua_objlen(L, 2);
+
+	conn->info = false;
+
+	int loaded = ora_dirpath_load(L, conn, 2, count > 0 ? (ub4)count : 0);
+	if (loaded < 0)
+		goto error;
+
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	lua_pushinteger(L, loaded);
+	return 3;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Finish direct path load making loaded rows visible
+ */
+static int
+lua_ora_dirpath_finish(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	conn->info = false;
+
+	if (ora_dirpath_finish(conn))
+		goto error;
+
+	lua_pushnumber(L, 0);
+	if (conn->info)
+		lua_pushstring(L, conn->message);
+	else
+		lua_pushnil(L);
+	return 2;
+
+error:
+	lua_pushinteger(L, 1);
+	int fail = safe_pushstring(L, conn->message);
+	return fail ? lua_push_error(L): 2;
+}
+
+/**
+ * Abort direct path load discarding loaded rows
+ */
+static int
+lua_ora_dirpath_abort(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+
+	ora_dirpath_free(conn, true);
+	lua_pushnumber(L, 0);
+	return 1;
+}
+
+/**
+ * Push runtime statistics of the connection
+ */
+static int
+lua_ora_stat(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	struct ora_stat *stat = &conn->stat;
+
+	lua_createtable(L, 0, 13);
+	luaL_pushuint64(L, stat->executes);
+	lua_setfield(L, -2, "executes");
+	luaL_pushuint64(L, stat->fetches);
+	lua_setfield(L, -2, "fetches");
+	luaL_pushuint64(L, stat->rows_fetched);
+	lua_setfield(L, -2, "rows_fetched");
+	luaL_pushuint64(L, stat->bytes_fetched);
+	lua_setfield(L, -2, "bytes_fetched");
+	luaL_pushuint64(L, stat->lob_bytes);
+	lua_setfield(L, -2, "lob_bytes");
+	luaL_pushuint64(L, stat->binds);
+	lua_setfield(L, -2, "binds");
+	luaL_pushuint64(L, stat->prepares);
+	lua_setfield(L, -2, "prepares");
+	luaL_pushuint64(L, stat->prepared_executes);
+	lua_setfield(L, -2, "prepared_executes");
+	luaL_pushuint64(L, ora_arena_capacity(&conn->arena));
+	lua_setfield(L, -2, "arena_size");
+	luaL_pushuint64(L, stat->coio_calls);
+	lua_setfield(L, -2, "coio_calls");
+	lua_pushnumber(L, stat->coio_wait_time);
+	lua_setfield(L, -2, "coio_wait_time");
+	lua_pushnumber(L, stat->oci_time);
+	lua_setfield(L, -2, "oci_time");
+	lua_pushnumber(L, stat->convert_time);
+	lua_setfield(L, -2, "convert_time");
+	return 1;
+}
+
+/**
+ * Push phase timings of the last statement
+ */
+static int
+lua_ora_timing(struct lua_State *L)
+{
+	struct ora_conn_ctx *conn = lua_check_oraconn(L, 1);
+	struct ora_timing *timing = &conn->timing;
+
+	lua_createtable(L, 0, 9);
+	lua_pushnumber(L, timing->prepare);
+	lua_setfield(L, -2, "prepare");
+	lua_pushnumber(L, timing->bind);
+	lua_setfield(L, -2, "bind");
+	lua_pushnumber(L, timing->execute);
+	lua_setfield(L, -2, "execute");
+	lua_pushnumber(L, timing->define);
+	lua_setfield(L, -2, "define");
+	lua_pushnumber(L, timing->fetch);
+	lua_setfield(L, -2, "fetch");
+	lua_pushnumber(L, timing->convert);
+	lua_setfield(L, -2, "convert");
+	lua_pushnumber(L, (double)timing->rows);
+	lua_setfield(L, -2, "rows");
+	lua_pushnumber(L, (double)timing->bytes);
+	lua_setfield(L, -2, "bytes");
+	lua_pushinteger(L, timing->binds);
+	lua_setfield(L, -2, "binds");
+	return 1;
+}
+
 /**
  * Close connection
  */
@@ -374,12 +1189,14 @@ lua_ora_close(struct lua_State *L)
 
 	if (conn->stmthp != NULL) {
 		if (conn->defines != NULL)
-			ora_free_defines(conn);
-		if (conn->binds != NULL)
-			ora_free_binds(0);
+			ora_free_defines(L, conn);
 		(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
 		conn->stmthp = NULL;
 	}
+	ora_stmt_free_all(L, conn);
+	ora_destroy_binds(conn);
+	ora_dirpath_free(conn, true);
+	ora_arena_destroy(&conn->arena);
 
 	(void) OCISessionEnd(conn->svchp, conn->errhp, conn->authp, (ub4)0);
 	if (conn->srvhp)
@@ -412,12 +1229,14 @@ lua_ora_gc(struct lua_State *L)
 
 	if (conn->stmthp != NULL) {
 		if (conn->defines != NULL)
-			ora_free_defines(conn);
-		if (conn->binds != NULL)
-			ora_free_binds(0);
+			ora_free_defines(L, conn);
 		(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
 		conn->stmthp = NULL;
 	}
+	ora_stmt_free_all(L, conn);
+	ora_destroy_binds(conn);
+	ora_dirpath_free(conn, true);
+	ora_arena_destroy(&conn->arena);
 
 	(void) OCISessionEnd(conn->svchp, conn->errhp, conn->authp, (ub4)0);
 	if (conn->srvhp)
@@ -489,6 +1308,7 @@ lua_ora_connect(struct lua_State *L)
 	}
 
 	struct ora_conn_ctx conn_ctx;
+	memset(&conn_ctx, 0, sizeof(conn_ctx));
 	conn_ctx.envhp = envhp;
 	conn_ctx.errhp = errhp;
 	conn_ctx.stmthp = NULL;
@@ -510,8 +1330,8 @@ lua_ora_connect(struct lua_State *L)
 	if (!checkerror(errcode, conn_ctx.errhp, message, sizeof(message), NULL))
 		goto fail_svchp;
 
-	errcode = oci_server_attach_coio(conn_ctx.srvhp, errhp, (text *)dbname,
-				  strlen((char *)dbname));
+	errcode = oci_server_attach_coio(&conn_ctx.stat, conn_ctx.srvhp, errhp,
+					 (text *)dbname, strlen((char *)dbname));
 	if (!checkerror(errcode, conn_ctx.errhp, message, sizeof(message), NULL))
 		goto fail_attach;
 
@@ -538,7 +1358,8 @@ lua_ora_connect(struct lua_State *L)
 	if (!checkerror(errcode, conn_ctx.errhp, message, sizeof(message), NULL))
 		goto fail_auth;
 
-	errcode = oci_session_begin_coio(conn_ctx.svchp, errhp, conn_ctx.authp);
+	errcode = oci_session_begin_coio(&conn_ctx.stat, conn_ctx.svchp, errhp,
+					 conn_ctx.authp);
 	if (!checkerror(errcode, conn_ctx.errhp, message, sizeof(message), NULL))
 		goto fail_auth;
 
@@ -583,15 +1404,36 @@ luaopen_ora_driver(lua_State *L)
 {
 	static const struct luaL_Reg methods [] = {
 		{"execute",	 lua_ora_execute},
+		{"execute_array", lua_ora_execute_array},
+		{"execute_batch", lua_ora_execute_batch},
 		{"cursor_open",	 lua_ora_cursor_open},
 		{"cursor_fetch", lua_ora_cursor_fetch},
+		{"cursor_fetch_batch", lua_ora_cursor_fetch_batch},
+		{"cursor_push_batch", lua_ora_cursor_push_batch},
+		{"cursor_view", lua_ora_cursor_view},
+		{"cursor_export", lua_ora_cursor_export},
 		{"cursor_close", lua_ora_cursor_close},
+		{"prepare",	 lua_ora_prepare},
+		{"stmt_execute", lua_ora_stmt_execute},
+		{"stmt_close",	 lua_ora_stmt_close},
+		{"commit",	 lua_ora_commit},
+		{"rollback",	 lua_ora_rollback},
+		{"dirpath_open", lua_ora_dirpath_open},
+		{"dirpath_load", lua_ora_dirpath_load},
+		{"dirpath_finish", lua_ora_dirpath_finish},
+		{"dirpath_abort", lua_ora_dirpath_abort},
+		{"stat",	 lua_ora_stat},
+		{"timing",	 lua_ora_timing},
 		{"close",	 lua_ora_close},
 		{"__tostring",	 lua_ora_tostring},
 		{"__gc",	 lua_ora_gc},
 		{NULL, NULL}
 	};
 
+	ora_binds_init(L);
+	ora_dirpath_init(L);
+	ora_stmt_init(L);
+
 	luaL_newmetatable(L, ora_driver_label);
 	lua_pushvalue(L, -1);
 	luaL_register(L, NULL, methods);
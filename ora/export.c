@@ -0,0 +1,673 @@
+#include "export.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <msgpuck.h>
+
+#include "async.h"
+#include "define.h"
+#include "util.h"
+
+/* output is written to the file by chunks of this size */
+#define ORA_EXPORT_BUFFER (1024 * 1024)
+
+enum ora_export_format {
+	ORA_EXPORT_CSV,
+	ORA_EXPORT_MSGPACK,
+	ORA_EXPORT_JSONL,
+	ORA_EXPORT_FORMATS
+};
+
+static const char *ora_export_formats[ORA_EXPORT_FORMATS] = {
+	"csv", "msgpack", "jsonl"
+};
+
+enum ora_value_type {
+	ORA_VALUE_NIL,
+	ORA_VALUE_STR,
+	ORA_VALUE_BIN,
+	ORA_VALUE_INT,
+	ORA_VALUE_UINT,
+	ORA_VALUE_DOUBLE,
+};
+
+/**
+ * Value of a column read from a define buffer
+ */
+struct ora_value {
+	enum ora_value_type type;
+	union {
+		struct {
+			const char *data;
+			size_t len;
+		} str;
+		int64_t int64;
+		uint64_t uint64;
+		double real;
+	};
+};
+
+/**
+ * Export job run by a worker thread. It owns the output buffer and the
+ * buffer LOB values are read into. Counters are added to statistics of
+ * the connection by TX thread when the job is done.
+ */
+struct ora_export {
+	struct ora_conn_ctx *conn;
+	const char *path;
+	enum ora_export_format format;
+	int fd;
+	char *buf;
+	size_t size;
+	size_t used;
+	char *lob;
+	size_t lob_size;
+	uint64_t rows;
+	uint64_t fetches;
+	uint64_t bytes;
+	uint64_t lob_bytes;
+	int rc;
+};
+
+static int
+ora_export_flush(struct ora_export *ex)
+{
+	size_t done = 0;
+	while (done < ex->used) {
+		ssize_t len = write(ex->fd, ex->buf + done, ex->used - done);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			snprintf(ex->conn->message, sizeof(ex->conn->message),
+				 "could not write %s: %s", ex->path,
+				 strerror(errno));
+			return -1;
+		}
+		done += len;
+	}
+	ex->used = 0;
+	return 0;
+}
+
+/**
+ * Get room for size bytes at the end of the output buffer. The buffer
+ * is written out if it has not enough room left and grows for values
+ * larger than it is.
+ */
+static char *
+ora_export_reserve(struct ora_export *ex, size_t size)
+{
+	if (ex->size - ex->used >= size)
+		return ex->buf + ex->used;
+	if (ora_export_flush(ex))
+		return NULL;
+	if (size > ex->size) {
+		char *buf = (char *)realloc(ex->buf, size);
+		if (buf == NULL) {
+			snprintf(ex->conn->message, sizeof(ex->conn->message),
+				 "%s %zu %s", "could not allocate ", size,
+				 "bytes");
+			return NULL;
+		}
+		ex->buf = buf;
+		ex->size = size;
+	}
+	return ex->buf;
+}
+
+static inline void
+ora_export_advance(struct ora_export *ex, char *end)
+{
+	ex->used = end - ex->buf;
+}
+
+static int
+ora_export_put(struct ora_export *ex, const char *data, size_t len)
+{
+	char *p = ora_export_reserve(ex, len);
+	if (p == NULL)
+		return -1;
+	memcpy(p, data, len);
+	ora_export_advance(ex, p + len);
+	return 0;
+}
+
+static int
+ora_export_hex(struct ora_export *ex, const char *data, size_t len,
+	       bool quoted)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *p = ora_export_reserve(ex, len * 2 + 2);
+	if (p == NULL)
+		return -1;
+	if (quoted)
+		*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		*p++ = digits[(unsigned char)data[i] >> 4];
+		*p++ = digits[(unsigned char)data[i] & 0xf];
+	}
+	if (quoted)
+		*p++ = '"';
+	ora_export_advance(ex, p);
+	return 0;
+}
+
+static int
+ora_export_number(struct ora_export *ex, const struct ora_value *value)
+{
+	char *p = ora_export_reserve(ex, 32);
+	if (p == NULL)
+		return -1;
+	int len;
+	if (value->type == ORA_VALUE_INT)
+		len = snprintf(p, 32, "%" PRId64, value->int64);
+	else if (value->type == ORA_VALUE_UINT)
+		len = snprintf(p, 32, "%" PRIu64, value->uint64);
+	else
+		len = snprintf(p, 32, "%.17g", value->real);
+	ora_export_advance(ex, p + len);
+	return 0;
+}
+
+/**
+ * Write a CSV field, quoted if it has a separator, a quote or a line
+ * break (RFC 4180)
+ */
+static int
+ora_export_csv_string(struct ora_export *ex, const char *data, size_t len)
+{
+	bool quote = false;
+	for (size_t i = 0; i < len && !quote; ++i)
+		quote = data[i] == ',' || data[i] == '"' ||
+			data[i] == '\n' || data[i] == '\r';
+	if (!quote)
+		return ora_export_put(ex, data, len);
+
+	char *p = ora_export_reserve(ex, len * 2 + 2);
+	if (p == NULL)
+		return -1;
+	*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		if (data[i] == '"')
+			*p++ = '"';
+		*p++ = data[i];
+	}
+	*p++ = '"';
+	ora_export_advance(ex, p);
+	return 0;
+}
+
+static int
+ora_export_json_string(struct ora_export *ex, const char *data, size_t len)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *p = ora_export_reserve(ex, len * 6 + 2);
+	if (p == NULL)
+		return -1;
+	*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = (unsigned char)data[i];
+		switch (c) {
+		case '"':
+		case '\\':
+			*p++ = '\\';
+			*p++ = c;
+			break;
+		case '\n':
+			*p++ = '\\';
+			*p++ = 'n';
+			break;
+		case '\r':
+			*p++ = '\\';
+			*p++ = 'r';
+			break;
+		case '\t':
+			*p++ = '\\';
+			*p++ = 't';
+			break;
+		default:
+			if (c >= 0x20) {
+				*p++ = c;
+				break;
+			}
+			*p++ = '\\';
+			*p++ = 'u';
+			*p++ = '0';
+			*p++ = '0';
+			*p++ = digits[c >> 4];
+			*p++ = digits[c & 0xf];
+			break;
+		}
+	}
+	*p++ = '"';
+	ora_export_advance(ex, p);
+	return 0;
+}
+
+static int
+ora_export_mp_string(struct ora_export *ex, const char *data, size_t len,
+		     bool binary)
+{
+	char *p = ora_export_reserve(ex, binary ? mp_sizeof_bin(len) :
+					  mp_sizeof_str(len));
+	if (p == NULL)
+		return -1;
+	p = binary ? mp_encode_bin(p, data, len) : mp_encode_str(p, data, len);
+	ora_export_advance(ex, p);
+	return 0;
+}
+
+static int
+ora_export_mp_value(struct ora_export *ex, const struct ora_value *value)
+{
+	if (value->type == ORA_VALUE_STR || value->type == ORA_VALUE_BIN)
+		return ora_export_mp_string(ex, value->str.data, value->str.len,
+					    value->type == ORA_VALUE_BIN);
+
+	char *p = ora_export_reserve(ex, 9);
+	if (p == NULL)
+		return -1;
+	switch (value->type) {
+	case ORA_VALUE_INT:
+		if (value->int64 < 0)
+			p = mp_encode_int(p, value->int64);
+		else
+			p = mp_encode_uint(p, (uint64_t)value->int64);
+		break;
+	case ORA_VALUE_UINT:
+		p = mp_encode_uint(p, value->uint64);
+		break;
+	case ORA_VALUE_DOUBLE:
+		p = mp_encode_double(p, value->real);
+		break;
+	default:
+		p = mp_encode_nil(p);
+		break;
+	}
+	ora_export_advance(ex, p);
+	return 0;
+}
+
+static int
+ora_export_csv_value(struct ora_export *ex, const struct ora_value *value)
+{
+	switch (value->type) {
+	case ORA_VALUE_NIL:
+		return 0;
+	case ORA_VALUE_STR:
+		return ora_export_csv_string(ex, value->str.data,
+					     value->str.len);
+	case ORA_VALUE_BIN:
+		return ora_export_hex(ex, value->str.data, value->str.len,
+				      false);
+	default:
+		return ora_export_number(ex, value);
+	}
+}
+
+static int
+ora_export_json_value(struct ora_export *ex, const struct ora_value *value)
+{
+	switch (value->type) {
+	case ORA_VALUE_NIL:
+		return ora_export_put(ex, "null", 4);
+	case ORA_VALUE_STR:
+		return ora_export_json_string(ex, value->str.data,
+					      value->str.len);
+	case ORA_VALUE_BIN:
+		return ora_export_hex(ex, value->str.data, value->str.len,
+				      true);
+	case ORA_VALUE_DOUBLE:
+		/* JSON has no NaN and infinities */
+		if (!isfinite(value->real))
+			return ora_export_put(ex, "null", 4);
+		return ora_export_number(ex, value);
+	default:
+		return ora_export_number(ex, value);
+	}
+}
+
+/**
+ * Read a LOB value into the LOB buffer of the job
+ */
+static int
+ora_export_lob(struct ora_export *ex, struct ora_define *define, ub4 row,
+	       struct ora_value *value)
+{
+	struct ora_conn_ctx *conn = ex->conn;
+	OCILobLocator *lob = ((OCILobLocator **)define->bufs[0].value)[row];
+	bool clob = define->dty == SQLT_CLOB;
+	sword errcode;
+
+	ub1 lob_cs = 0;
+	if (clob) {
+		errcode = OCILobCharSetForm(conn->envhp, conn->errhp, lob,
+					    &lob_cs);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+	}
+	ub4 lob_length;
+	errcode = OCILobGetLength(conn->svchp, conn->errhp, lob, &lob_length);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+
+	value->type = clob ? ORA_VALUE_STR : ORA_VALUE_BIN;
+	value->str.data = "";
+	value->str.len = 0;
+	if (lob_length == 0)
+		return 0;
+
+	/* length of a CLOB is in characters of up to 4 bytes */
+	size_t size = clob ? (size_t)lob_length * 4 : lob_length;
+	if (size > ex->lob_size) {
+		char *lob_buf = (char *)realloc(ex->lob, size);
+		if (lob_buf == NULL) {
+			snprintf(conn->message, sizeof(conn->message),
+				 "%s %zu %s", "could not allocate ", size,
+				 "bytes");
+			return -1;
+		}
+		ex->lob = lob_buf;
+		ex->lob_size = size;
+	}
+
+	ub4 data_read = lob_length;
+	errcode = OCILobRead(conn->svchp, conn->errhp, lob, &data_read,
+			     (ub4)1, ex->lob, (ub4)size, (void *)NULL,
+			     (OCICallbackLobRead)NULL, (ub2)0, lob_cs);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	ex->lob_bytes += data_read;
+	value->str.data = ex->lob;
+	value->str.len = data_read;
+	return 0;
+}
+
+/**
+ * Read a value of a column from the first define buffer set, the same
+ * way ora_push_row converts it to lua
+ */
+static int
+ora_export_value(struct ora_export *ex, struct ora_define *define, ub4 row,
+		 struct ora_value *value)
+{
+	struct ora_conn_ctx *conn = ex->conn;
+	struct ora_define_buf *buf = define->bufs;
+	sword errcode;
+
+	if (buf->ind[row] == -1) {
+		value->type = ORA_VALUE_NIL;
+		return 0;
+	}
+
+	switch (define->type) {
+	case OCI_TYPECODE_NUMBER: {
+		OCINumber *number = (OCINumber *)buf->value + row;
+		boolean is_int;
+		errcode = OCINumberIsInt(conn->errhp, number, &is_int);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+		if (is_int) {
+			value->type = ORA_VALUE_INT;
+			errcode = OCINumberToInt(conn->errhp, number,
+						 sizeof(value->int64),
+						 OCI_NUMBER_SIGNED,
+						 &value->int64);
+		} else {
+			value->type = ORA_VALUE_DOUBLE;
+			errcode = OCINumberToReal(conn->errhp, number,
+						  sizeof(value->real),
+						  &value->real);
+		}
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			return -1;
+		break;
+	}
+
+	case OCI_TYPECODE_REAL:
+	case OCI_TYPECODE_DOUBLE:
+		value->type = ORA_VALUE_DOUBLE;
+		value->real = ((double *)buf->value)[row];
+		break;
+
+	case OCI_TYPECODE_OCTET:
+	case OCI_TYPECODE_UNSIGNED16:
+	case OCI_TYPECODE_UNSIGNED32:
+		value->type = ORA_VALUE_UINT;
+		value->uint64 = ((uint64_t *)buf->value)[row];
+		break;
+
+	case OCI_TYPECODE_SIGNED8:
+	case OCI_TYPECODE_SIGNED16:
+	case OCI_TYPECODE_SIGNED32:
+	case OCI_TYPECODE_SMALLINT:
+	case OCI_TYPECODE_INTEGER:
+		value->type = ORA_VALUE_INT;
+		value->int64 = ((int64_t *)buf->value)[row];
+		break;
+
+	case OCI_TYPECODE_BLOB:
+	case OCI_TYPECODE_CLOB:
+		return ora_export_lob(ex, define, row, value);
+
+	case SQLT_BIN:
+	case SQLT_LBI:
+		value->type = ORA_VALUE_BIN;
+		value->str.data = (char *)buf->value +
+				  (size_t)define->value_size * row;
+		value->str.len = buf->len[row];
+		break;
+
+	default:
+		/* varchar or implicitly converted to string by define */
+		value->type = ORA_VALUE_STR;
+		value->str.data = (char *)buf->value +
+				  (size_t)define->value_size * row;
+		value->str.len = buf->len[row];
+		break;
+	}
+	ex->bytes += buf->len[row];
+	return 0;
+}
+
+static int
+ora_export_header(struct ora_export *ex)
+{
+	struct ora_conn_ctx *conn = ex->conn;
+	for (ub4 col_index = 0; col_index < conn->define_count; ++col_index) {
+		struct ora_define *define = conn->defines + col_index;
+		if (col_index > 0 && ora_export_put(ex, ",", 1))
+			return -1;
+		if (ora_export_csv_string(ex, define->col_name,
+					  define->col_name_len))
+			return -1;
+	}
+	return ora_export_put(ex, "\n", 1);
+}
+
+/**
+ * Encode a row: a CSV line, or a map of column names to values in
+ * msgpack or a JSON line
+ */
+static int
+ora_export_row(struct ora_export *ex, ub4 row)
+{
+	struct ora_conn_ctx *conn = ex->conn;
+
+	if (ex->format == ORA_EXPORT_MSGPACK) {
+		char *p = ora_export_reserve(ex, mp_sizeof_map(conn->define_count));
+		if (p == NULL)
+			return -1;
+		ora_export_advance(ex, mp_encode_map(p, conn->define_count));
+	} else if (ex->format == ORA_EXPORT_JSONL) {
+		if (ora_export_put(ex, "{", 1))
+			return -1;
+	}
+
+	for (ub4 col_index = 0; col_index < conn->define_count; ++col_index) {
+		struct ora_define *define = conn->defines + col_index;
+		struct ora_value value;
+		if (ora_export_value(ex, define, row, &value))
+			return -1;
+
+		int rc;
+		switch (ex->format) {
+		case ORA_EXPORT_CSV:
+			rc = (col_index > 0 && ora_export_put(ex, ",", 1)) ||
+			     ora_export_csv_value(ex, &value);
+			break;
+		case ORA_EXPORT_MSGPACK:
+			rc = ora_export_mp_string(ex, define->col_name,
+						  define->col_name_len, false) ||
+			     ora_export_mp_value(ex, &value);
+			break;
+		default:
+			rc = (col_index > 0 && ora_export_put(ex, ",", 1)) ||
+			     ora_export_json_string(ex, define->col_name,
+						    define->col_name_len) ||
+			     ora_export_put(ex, ":", 1) ||
+			     ora_export_json_value(ex, &value);
+			break;
+		}
+		if (rc)
+			return -1;
+	}
+
+	if (ex->format == ORA_EXPORT_CSV)
+		return ora_export_put(ex, "\n", 1);
+	if (ex->format == ORA_EXPORT_JSONL)
+		return ora_export_put(ex, "}\n", 2);
+	return 0;
+}
+
+/**
+ * Fetch all batches of the cursor and write them to the file. Runs in a
+ * worker thread.
+ */
+static int
+ora_export_run(struct ora_export *ex)
+{
+	struct ora_conn_ctx *conn = ex->conn;
+	sword errcode;
+	int rc = -1;
+
+	ex->buf = (char *)malloc(ORA_EXPORT_BUFFER);
+	if (ex->buf == NULL) {
+		snprintf(conn->message, sizeof(conn->message), "%s %d %s",
+			 "could not allocate ", ORA_EXPORT_BUFFER, "bytes");
+		return -1;
+	}
+	ex->size = ORA_EXPORT_BUFFER;
+
+	ex->fd = open(ex->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (ex->fd < 0) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not open %s: %s", ex->path, strerror(errno));
+		return -1;
+	}
+
+	if (ex->format == ORA_EXPORT_CSV && ora_export_header(ex))
+		goto done;
+
+	bool eof = false;
+	while (!eof) {
+		errcode = OCIStmtFetch2(conn->stmthp, conn->errhp,
+					conn->define_rows, OCI_FETCH_NEXT, 0,
+					OCI_DEFAULT);
+		++ex->fetches;
+		if (errcode == OCI_NO_DATA)
+			eof = true;
+		else if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			goto done;
+
+		ub4 count = 0;
+		errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT,
+				     (void *)&count, (ub4 *)0,
+				     (ub4)OCI_ATTR_ROWS_FETCHED,
+				     (OCIError *)conn->errhp);
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			goto done;
+		for (ub4 row = 0; row < count; ++row) {
+			if (ora_export_row(ex, row))
+				goto done;
+		}
+		ex->rows += count;
+	}
+	if (ora_export_flush(ex))
+		goto done;
+	rc = 0;
+
+done:
+	if (close(ex->fd) != 0 && rc == 0) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not write %s: %s", ex->path, strerror(errno));
+		rc = -1;
+	}
+	return rc;
+}
+
+static ssize_t
+ora_export_cb(va_list ap)
+{
+	struct ora_export *ex = va_arg(ap, struct ora_export *);
+	ex->rc = ora_export_run(ex);
+	return 0;
+}
+
+/**
+ * Write all rows of the open cursor to a file in the given format. The
+ * cursor is fetched into the first define buffer set, values are
+ * encoded from it and written with large writes by a single worker
+ * thread job, no lua values are created. Count of written rows is
+ * returned in rows.
+ */
+int
+ora_export(struct ora_conn_ctx *conn, const char *path, const char *format,
+	   uint64_t *rows)
+{
+	struct ora_export ex;
+	memset(&ex, 0, sizeof(ex));
+	ex.conn = conn;
+	ex.path = path;
+	ex.fd = -1;
+
+	int idx = 0;
+	while (idx < ORA_EXPORT_FORMATS &&
+	       strcmp(format, ora_export_formats[idx]) != 0)
+		++idx;
+	if (idx == ORA_EXPORT_FORMATS) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "unknown export format %s", format);
+		return -1;
+	}
+	ex.format = (enum ora_export_format)idx;
+
+	if (conn->define_set != 0 && ora_define_set(conn, 0))
+		return -1;
+
+	double start = clock_monotonic();
+	struct ora_coio_timing timing;
+	ora_coio_timing_start(&timing);
+	coio_call(ora_timed_cb, &timing, ora_export_cb, &ex);
+	ora_stat_coio(&conn->stat, &timing);
+	conn->timing.fetch += clock_monotonic() - start;
+
+	free(ex.buf);
+	free(ex.lob);
+	conn->fetch_eof = true;
+	conn->stat.fetches += ex.fetches;
+	conn->stat.rows_fetched += ex.rows;
+	conn->stat.bytes_fetched += ex.bytes;
+	conn->stat.lob_bytes += ex.lob_bytes;
+	conn->timing.rows += ex.rows;
+	conn->timing.bytes += ex.bytes + ex.lob_bytes;
+	*rows = ex.rows;
+	return ex.rc;
+}
@@ -0,0 +1,12 @@
+#ifndef ORA_EXPORT_H
+#define ORA_EXPORT_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+int
+ora_export(struct ora_conn_ctx *conn, const char *path, const char *format,
+	   uint64_t *rows);
+
+#endif
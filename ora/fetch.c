@@ -1,8 +1,11 @@
 #include "fetch.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "async.h"
+#include "define.h"
+#include "stmt.h"
 #include "util.h"
 
 int
@@ -10,35 +13,82 @@ ora_fetch_row(struct ora_conn_ctx *conn)
 {
 	sword errcode;
 
-	errcode = oci_stmt_fetch_coio(conn->stmthp, conn->errhp, 1);
+	double start = clock_monotonic();
+	errcode = oci_stmt_fetch_coio(&conn->stat, conn->stmthp, conn->errhp, 1);
+	conn->timing.fetch += clock_monotonic() - start;
+	++conn->stat.fetches;
 	if (errcode == OCI_NO_DATA)
 		return 0;
 
 	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 		return -1;
+	++conn->stat.rows_fetched;
+	++conn->timing.rows;
 	return 1;
 }
 
 int
-ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn)
+ora_fetch_batch(struct ora_conn_ctx *conn, int set)
+{
+	sword errcode;
+
+	if (conn->fetch_eof)
+		return 0;
+
+	if (set != conn->define_set && ora_define_set(conn, set))
+		return -1;
+
+	double start = clock_monotonic();
+	errcode = oci_stmt_fetch2_coio(&conn->stat, conn->stmthp, conn->errhp,
+				       conn->define_rows);
+	conn->timing.fetch += clock_monotonic() - start;
+	++conn->stat.fetches;
+	if (errcode == OCI_NO_DATA)
+		conn->fetch_eof = true;
+	else if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+
+	ub4 rows = 0;
+	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&rows,
+			     (ub4 *)0, (ub4)OCI_ATTR_ROWS_FETCHED,
+			     (OCIError *)conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	conn->stat.rows_fetched += rows;
+	conn->timing.rows += rows;
+	return (int)rows;
+}
+
+int
+ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn, int set, ub4 row)
 {
 	sword errcode;
 	boolean is_int;
 
-	lua_newtable(L);
+	lua_createtable(L, 0, conn->define_count);
 
 	for (ub4 col_index = 0; col_index < conn->define_count; ++col_index) {
 		struct ora_define *define = conn->defines + col_index;
-		lua_pushlstring(L, define->col_name, define->col_name_len);
+		struct ora_define_buf *buf = define->bufs + set;
+		lua_rawgeti(L, LUA_REGISTRYINDEX, define->name_ref);
 		switch (define->type) {
 		case OCI_TYPECODE_VARCHAR:
 		case OCI_TYPECODE_VARCHAR2:
-			lua_pushlstring(L, define->string.value,
-					define->string.len);
+			lua_pushlstring(L, (char *)buf->value +
+					(size_t)define->value_size * row,
+					buf->ind[row] == -1 ? 0 : buf->len[row]);
+			break;
+
+		case SQLT_BIN:
+		case SQLT_LBI:
+			lua_pushlstring(L, (char *)buf->value +
+					(size_t)define->value_size * row,
+					buf->ind[row] == -1 ? 0 : buf->len[row]);
 			break;
 
-		case OCI_TYPECODE_NUMBER:
-			errcode = OCINumberIsInt(conn->errhp, &define->number,
+		case OCI_TYPECODE_NUMBER: {
+			OCINumber *number = (OCINumber *)buf->value + row;
+			errcode = OCINumberIsInt(conn->errhp, number,
 						 &is_int);
 			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
 				return -1;
@@ -47,7 +97,7 @@ ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn)
 			if (is_int) {
 				ub8 inum;
 				errcode = OCINumberToInt(conn->errhp,
-							 &define->number,
+							 number,
 							 sizeof(inum),
 							 OCI_NUMBER_SIGNED,
 							 &inum);
@@ -58,7 +108,7 @@ ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn)
 			} else {
 				double dnum;
 				errcode = OCINumberToReal(conn->errhp,
-							  &define->number,
+							  number,
 							  sizeof(dnum),
 							  &dnum);
 				if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
@@ -68,17 +118,17 @@ ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn)
 				lua_pushnumber(L, dnum);
 			}
 			break;
+		}
 
 		case OCI_TYPECODE_REAL:
 		case OCI_TYPECODE_DOUBLE:
-			lua_pushnumber(L, define->double64);
+			lua_pushnumber(L, ((double *)buf->value)[row]);
 			break;
 
 		case OCI_TYPECODE_OCTET:
-		case OCI_TYPECODE_UNSIGNED8:
 		case OCI_TYPECODE_UNSIGNED16:
 		case OCI_TYPECODE_UNSIGNED32:
-			lua_pushinteger(L, define->uint64);
+			lua_pushinteger(L, ((uint64_t *)buf->value)[row]);
 			break;
 
 		case OCI_TYPECODE_SIGNED8:
@@ -86,81 +136,117 @@ ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn)
 		case OCI_TYPECODE_SIGNED32:
 		case OCI_TYPECODE_SMALLINT:
 		case OCI_TYPECODE_INTEGER:
-			lua_pushinteger(L, define->int64);
+			lua_pushinteger(L, ((int64_t *)buf->value)[row]);
 			break;
 
 		case OCI_TYPECODE_BLOB: {
+			OCILobLocator *blob = ((OCILobLocator **)buf->value)[row];
 			ub4 lob_length;
 			ub4 data_read;
 			errcode = OCILobGetLength(conn->svchp, conn->errhp,
-						  define->blob, &lob_length);
+						  blob, &lob_length);
 			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 				return -1;
 
 			data_read = lob_length;
-			void *buffer = malloc(lob_length);
+			size_t mark = ora_arena_used(&conn->arena);
+			void *buffer = ora_arena_alloc(&conn->arena, lob_length);
 			if (buffer == NULL) {
 				snprintf(conn->message, sizeof(conn->message),
 					 "%s %u %s", "could not allocate ",
 					 lob_length, "bytes");
 				return -1;
 			}
-			errcode = oci_blob_read_coio(conn->svchp, conn->errhp,
-						     define->blob, &data_read,
-						     buffer, lob_length);
+			errcode = oci_blob_read_coio(&conn->stat, conn->svchp,
+						     conn->errhp, blob, buffer,
+						     &data_read,
+						     lob_length);
 			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
-				free(buffer);
+				ora_arena_truncate(&conn->arena, mark);
 				return -1;
 			}
 
+			conn->stat.lob_bytes += data_read;
+			conn->timing.bytes += data_read;
 			lua_pushlstring(L, buffer, data_read);
-			free(buffer);
+			ora_arena_truncate(&conn->arena, mark);
 			break;
 		}
 
 		case OCI_TYPECODE_CLOB: {
+			OCILobLocator *clob = ((OCILobLocator **)buf->value)[row];
 			ub1 lob_cs;
-			errcode = OCILobCharSetForm(conn->envhp, conn->errhp, define->clob, &lob_cs);
+			errcode = OCILobCharSetForm(conn->envhp, conn->errhp, clob, &lob_cs);
 			ub4 lob_length;
 			ub4 data_read;
 			errcode = OCILobGetLength(conn->svchp, conn->errhp,
-						  define->blob, &lob_length);
+						  clob, &lob_length);
 			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
 				return -1;
 
 			data_read = lob_length;
-			void *buffer = malloc(lob_length * 4);
+			size_t mark = ora_arena_used(&conn->arena);
+			void *buffer = ora_arena_alloc(&conn->arena, lob_length * 4);
 			if (buffer == NULL) {
 				snprintf(conn->message, sizeof(conn->message),
 					 "%s %u %s", "could not allocate ",
 					 lob_length, "bytes");
 				return -1;
 			}
-			errcode = oci_clob_read_coio(conn->svchp, conn->errhp,
-						     define->clob, &data_read,
-						     buffer, lob_length * 4,
+			errcode = oci_clob_read_coio(&conn->stat, conn->svchp,
+						     conn->errhp, clob, buffer,
+						     &data_read,
+						     lob_length * 4,
 						     (ub1)lob_cs);
 			if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info)) {
-				free(buffer);
+				ora_arena_truncate(&conn->arena, mark);
 				return -1;
 			}
 
+			conn->stat.lob_bytes += data_read;
+			conn->timing.bytes += data_read;
 			lua_pushlstring(L, buffer, data_read);
-			free(buffer);
+			ora_arena_truncate(&conn->arena, mark);
 			break;
 		}
 
 		default:
-			snprintf(conn->message, sizeof(conn->message),
-				 "UNREACHABLE: invalid DEFINE type %d\n", define->type);
-			return -1;
+			/* implicitly converted to string by define */
+			lua_pushlstring(L, (char *)buf->value +
+					(size_t)define->value_size * row,
+					buf->ind[row] == -1 ? 0 : buf->len[row]);
+			break;
 		}
-		lua_settable(L, -3);
+		if (buf->ind[row] != -1 && define->dty != SQLT_BLOB &&
+		    define->dty != SQLT_CLOB) {
+			conn->stat.bytes_fetched += buf->len[row];
+			conn->timing.bytes += buf->len[row];
+		}
+		lua_rawset(L, -3);
 	}
 
 	return 1;
 }
 
+int
+ora_push_batch(struct lua_State *L, struct ora_conn_ctx *conn, int set,
+	       ub4 count)
+{
+	double start = clock_monotonic();
+	lua_createtable(L, count, 0);
+	for (ub4 row = 0; row < count; ++row) {
+		if (ora_push_row(L, conn, set, row) < 0) {
+			lua_pop(L, 1);
+			return -1;
+		}
+		lua_rawseti(L, -2, row + 1);
+	}
+	double convert = clock_monotonic() - start;
+	conn->stat.convert_time += convert;
+	conn->timing.convert += convert;
+	return 0;
+}
+
 int
 ora_fetch_and_push_all(struct lua_State *L, struct ora_conn_ctx *conn)
 {
@@ -171,11 +257,15 @@ ora_fetch_and_push_all(struct lua_State *L, struct ora_conn_ctx *conn)
 	while (fetched == 1) {
 		lua_pushnumber(L, row + 1);
 
-		if (ora_push_row(L, conn) < 0) {
+		double start = clock_monotonic();
+		if (ora_push_row(L, conn, conn->define_set, 0) < 0) {
 			lua_pop(L, 1);
 			return -1;
 		}
 		lua_settable(L, -3);
+		double convert = clock_monotonic() - start;
+		conn->stat.convert_time += convert;
+		conn->timing.convert += convert;
 
 		++row;
 		fetched = ora_fetch_row(conn);
@@ -184,4 +274,92 @@ ora_fetch_and_push_all(struct lua_State *L, struct ora_conn_ctx *conn)
 	return fetched;
 }
 
+/**
+ * Fetch all rows of a result set returned by the executed statement: a
+ * ref cursor or an implicit result. Rows are array fetched into defines
+ * of the result which stand in for the ones of the connection meanwhile.
+ */
+int
+ora_fetch_result(struct lua_State *L, struct ora_conn_ctx *conn,
+		 OCIStmt *result)
+{
+	struct ora_stmt saved;
+	memset(&saved, 0, sizeof(saved));
+	saved.stmthp = result;
+	ora_stmt_swap(conn, &saved);
+
+	lua_newtable(L);
+	if (ora_make_defines(L, conn, ORA_RESULT_ROWS, 1, true))
+		goto fail_defines;
+
+	int count;
+	ub4 rows = 0;
+	while ((count = ora_fetch_batch(conn, 0)) > 0) {
+		double start = clock_monotonic();
+		for (int row = 0; row < count; ++row) {
+			if (ora_push_row(L, conn, 0, row) < 0)
+				goto fail_fetch;
+			lua_rawseti(L, -2, ++rows);
+		}
+		double convert = clock_monotonic() - start;
+		conn->stat.convert_time += convert;
+		conn->timing.convert += convert;
+	}
+	if (count < 0)
+		goto fail_fetch;
 
+	ora_free_defines(L, conn);
+	ora_stmt_swap(conn, &saved);
+	return 0;
+
+fail_fetch:
+	ora_free_defines(L, conn);
+
+fail_defines:
+	lua_pop(L, 1);
+	ora_stmt_swap(conn, &saved);
+	return -1;
+}
+
+/**
+ * Fetch implicit results of an executed PL/SQL block, returned with
+ * DBMS_SQL.RETURN_RESULT. Pushes an array of result sets or nothing if
+ * there are none. Returns count of pushed values or -1 on error.
+ */
+int
+ora_fetch_implicit_results(struct lua_State *L, struct ora_conn_ctx *conn)
+{
+	sword errcode;
+	ub4 count = 0;
+	errcode = OCIAttrGet(conn->stmthp, OCI_HTYPE_STMT, (void *)&count,
+			     (ub4 *)0, (ub4)OCI_ATTR_IMPLICIT_RESULT_COUNT,
+			     (OCIError *)conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		return -1;
+	if (count == 0)
+		return 0;
+
+	lua_createtable(L, count, 0);
+	ub4 idx = 0;
+	for (;;) {
+		void *result = NULL;
+		ub4 type = 0;
+		errcode = OCIStmtGetNextResult(conn->stmthp, conn->errhp,
+					       &result, &type, OCI_DEFAULT);
+		if (errcode == OCI_NO_DATA)
+			break;
+		if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+			goto fail;
+		if (type != OCI_RESULT_TYPE_SELECT)
+			continue;
+		/* handles of implicit results are freed with the statement */
+		if (ora_fetch_result(L, conn, (OCIStmt *)result))
+			goto fail;
+		lua_rawseti(L, -2, ++idx);
+	}
+	return 1;
+
+fail:
+	lua_pop(L, 1);
+	return -1;
+}
@@ -11,9 +11,23 @@ int
 ora_fetch_row(struct ora_conn_ctx *conn);
 
 int
-ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn);
+ora_fetch_batch(struct ora_conn_ctx *conn, int set);
+
+int
+ora_push_row(struct lua_State *L, struct ora_conn_ctx *conn, int set, ub4 row);
+
+int
+ora_push_batch(struct lua_State *L, struct ora_conn_ctx *conn, int set,
+	       ub4 count);
 
 int
 ora_fetch_and_push_all(struct lua_State *L, struct ora_conn_ctx *conn);
 
+int
+ora_fetch_result(struct lua_State *L, struct ora_conn_ctx *conn,
+		 OCIStmt *result);
+
+int
+ora_fetch_implicit_results(struct lua_State *L, struct ora_conn_ctx *conn);
+
 #endif
@@ -1,39 +1,195 @@
 -- init.lua (internal file)
 
 local fiber = require('fiber')
+local clock = require('clock')
+local log = require('log')
+local json = require('json')
 local driver = require('ora.driver')
+local cache = require('ora.cache')
+local view = require('ora.view')
+local metrics = require('ora.metrics')
 local ffi = require('ffi')
 
 local pool_mt
 local conn_mt
+local stmt_mt
 
---create a new connection
-local function conn_create(ora_conn, raise)
+-- Lua side statistics of driver connections. They are kept by the
+-- driver connection, so pooled connections keep their counters across
+-- checkouts.
+local conn_stats = setmetatable({}, {__mode = 'k'})
+
+-- Create a new connection. Options are raise, cache, slow_query,
+-- log_binds and autocommit, a pool passes itself.
+local function conn_create(ora_conn, opts)
     local queue = fiber.channel(1)
     queue:put(true)
+    local stats = conn_stats[ora_conn]
+    if stats == nil then
+        stats = {guard_wait_time = 0, errors = {}}
+        conn_stats[ora_conn] = stats
+    end
     local conn = setmetatable({
         usable = true,
         conn = ora_conn,
         queue = queue,
-        raise = raise,
+        raise = opts.raise,
+        cache = opts.cache,
+        slow_query = opts.slow_query,
+        log_binds = opts.log_binds,
+        autocommit = opts.autocommit,
+        stats = stats,
     }, conn_mt)
 
     return conn
 end
 
+-- Take the connection guard, accounting the time spent waiting for it.
+local function conn_lock(self)
+    local start = clock.monotonic()
+    local ok = self.queue:get()
+    self.stats.guard_wait_time = self.stats.guard_wait_time +
+                                 clock.monotonic() - start
+    if ok and self.cursor_abandoned ~= nil then
+        -- an iterator was collected before the end of its cursor, the
+        -- collector can not wait for the guard so it is closed here
+        if self.cursor_abandoned == self.cursor_id then
+            self.conn:cursor_close()
+            self.cursor_id = nil
+            self.trace = nil
+        end
+        self.cursor_abandoned = nil
+    end
+    return ok
+end
+
+-- Errors after which the connection is lost
+local lost_errors = {
+    ['ORA-03113'] = true,
+    ['ORA-03114'] = true,
+    ['ORA-03135'] = true,
+    ['ORA-12609'] = true,
+}
+
+-- Count an error by its ORA code. Returns true if the connection is
+-- still usable after the error.
+local function conn_error(self, status, msg)
+    local code = type(msg) == 'string' and msg:match('ORA%-(%d+)')
+    code = code and 'ORA-' .. code or 'other'
+    local errors = self.stats.errors
+    errors[code] = (errors[code] or 0) + 1
+    return status > 0 and not lost_errors[code]
+end
+
+-- Start tracing a statement for the slow query log and metrics.
+local function trace_start(self, sql, args)
+    if self.slow_query == nil and not metrics.enabled() then
+        return nil
+    end
+    return {
+        sql = sql,
+        args = args,
+        start = clock.monotonic(),
+        guard_wait = self.stats.guard_wait_time,
+    }
+end
+
+-- Feed a traced statement to metrics and log it if it took longer than
+-- the slow query threshold. Must be called under the connection guard
+-- as it reads the timings of the last statement from the driver. Bind
+-- values are only logged with the log_binds option.
+local function trace_finish(self, trace, failed)
+    if trace == nil then
+        return
+    end
+    local elapsed = clock.monotonic() - trace.start
+    local slow = self.slow_query ~= nil and elapsed >= self.slow_query
+    if not slow and not metrics.enabled() then
+        return
+    end
+    local t = self.conn:timing()
+    if metrics.enabled() then
+        metrics.observe(trace.sql, elapsed, t, failed)
+    end
+    if not slow then
+        return
+    end
+    local binds = self.log_binds and json.encode(trace.args or {}) or 'redacted'
+    log.warn('ora: slow statement %.3f s, %d binds, %d rows, %d bytes; ' ..
+             'guard wait %.3f, prepare %.3f, bind %.3f, execute %.3f, ' ..
+             'define %.3f, fetch %.3f, convert %.3f; sql: %s; binds: %s',
+             elapsed, t.binds, t.rows, t.bytes,
+             self.stats.guard_wait_time - trace.guard_wait,
+             t.prepare, t.bind, t.execute, t.define, t.fetch, t.convert,
+             trace.sql, binds)
+end
+
+-- Commit on success of a statement: per call option or the one of the
+-- connection.
+local function conn_autocommit(self, opts)
+    if opts ~= nil and opts.autocommit ~= nil then
+        return opts.autocommit
+    end
+    return self.autocommit or false
+end
+
+-- End the transaction with OCITransCommit or OCITransRollback, which
+-- take one round trip and no statement.
+local function conn_trans(self, method)
+    if not self.usable then
+        if self.raise then
+            return error('Connection is not usable')
+        end
+        return false, 'Connection is not usable'
+    end
+    if not conn_lock(self) then
+        self.queue:put(false)
+        if self.raise then
+            return error('Connection is broken')
+        end
+        return false, 'Connection is broken'
+    end
+    local status, msg = self.conn[method](self.conn)
+    if status ~= 0 then
+        self.queue:put(conn_error(self, status, msg))
+        if self.raise then
+            return error(msg)
+        end
+        return false, msg
+    end
+    self.queue:put(true)
+    return true, msg
+end
+
+local function conn_stat(self)
+    local res = self.conn:stat()
+    res.guard_wait_time = self.stats.guard_wait_time
+    res.errors = table.copy(self.stats.errors)
+    return res
+end
+
 -- get connection from pool
 local function conn_get(pool)
+    local start = clock.monotonic()
+    local stats = pool.stats
+    stats.waiting = stats.waiting + 1
     local ora_conn = pool.queue:get()
+    stats.waiting = stats.waiting - 1
+    stats.wait_time = stats.wait_time + clock.monotonic() - start
     local status
     if ora_conn == nil then
         status, ora_conn = driver.connect(pool.conn_string, pool.user, pool.pass)
         if status < 0 then
             return error(ora_conn)
         end
+        pool.conns[ora_conn] = true
     end
-    local conn = conn_create(ora_conn, pool.raise)
+    stats.checkouts = stats.checkouts + 1
+    stats.in_use = stats.in_use + 1
+    local conn = conn_create(ora_conn, pool)
     conn.__gc_hook = ffi.gc(ffi.new('void *'),
         function(self)
+            stats.in_use = stats.in_use - 1
             pool.queue:put(ora_conn)
         end)
     return conn
@@ -42,50 +198,554 @@ end
 local function conn_put(conn)
     local oraconn = conn.conn
     ffi.gc(conn.__gc_hook, nil)
-    if not conn.queue:get() then
+    if not conn_lock(conn) then
+        -- a broken connection is dropped, the pool reconnects instead
         conn.usable = false
-        conn:close()
+        pcall(oraconn.close, oraconn)
         return nil
     end
+    -- a cursor left by an abandoned iterator is not passed on
+    oraconn:cursor_close()
     conn.usable = false
     return oraconn
 end
 
+-- Call a driver method under the connection guard. Errors are always
+-- raised as there is no way to return them through an iterator.
+local function conn_call(self, method, ...)
+    if not self.usable then
+        return error('Connection is not usable')
+    end
+    if not conn_lock(self) then
+        self.queue:put(false)
+        return error('Connection is broken')
+    end
+    local status, msg, data = self.conn[method](self.conn, ...)
+    if status ~= 0 then
+        self.queue:put(conn_error(self, status, msg))
+        return error(msg)
+    end
+    self.queue:put(true)
+    return data
+end
+
+-- Register a cursor opened by the driver. Returns its id, which is
+-- reset by cursor_close.
+local function cursor_opened(self, trace)
+    self.cursor_seq = (self.cursor_seq or 0) + 1
+    self.cursor_id = self.cursor_seq
+    self.trace = trace
+    return self.cursor_id
+end
+
+-- Open a cursor of an iterator or an export. Returns the read-ahead
+-- flag and the cursor id. A failure is traced here as there is no
+-- cursor to close then.
+local function cursor_open(self, sql, args, trace, ...)
+    if not self.usable then
+        return error('Connection is not usable')
+    end
+    if not conn_lock(self) then
+        self.queue:put(false)
+        return error('Connection is broken')
+    end
+    local status, msg, readahead = self.conn:cursor_open(sql, args or {}, ...)
+    if status ~= 0 then
+        trace_finish(self, trace, true)
+        self.queue:put(conn_error(self, status, msg))
+        return error(msg)
+    end
+    local id = cursor_opened(self, trace)
+    self.queue:put(true)
+    return readahead, id
+end
+
+-- Fetch batches of a cursor into two define buffer sets. Every call
+-- returns the set and row count of the next batch and starts fetching
+-- the one after it into the other set, so the returned set stays intact
+-- until the next call. Returns nil at the end of the cursor.
+--
+-- With the convert flag the batch is converted to lua tables under the
+-- guard before the read-ahead of the next one starts, as conversion
+-- calls OCI for numbers and LOB values and the environment is not
+-- threaded. The rows are returned instead of the set, and the consumer
+-- processes them while the next batch is being fetched.
+--
+-- If the iterator is collected before the end of the cursor, the
+-- cursor is closed on the next take of the guard.
+local function cursor_batches(self, sql, args, opts, view, convert)
+    local trace = trace_start(self, sql, args)
+    local readahead, id = cursor_open(self, sql, args, trace,
+                                      opts.batch or 100, view)
+    local watch = ffi.gc(ffi.new('void *'), function()
+        if self.cursor_id == id then
+            self.cursor_abandoned = id
+        end
+    end)
+    local set = 0
+    local count = conn_call(self, 'cursor_fetch_batch', set)
+    local prefetch = fiber.channel(1)
+    local pending = false
+
+    return function()
+        if pending then
+            pending = false
+            local res = prefetch:get()
+            if not res[1] then
+                return error(res[2])
+            end
+            count = res[2]
+        elseif count == nil then
+            -- without read-ahead the next batch is fetched on demand
+            count = conn_call(self, 'cursor_fetch_batch', set)
+        end
+        if count == 0 then
+            -- the caller closes the cursor at the end
+            ffi.gc(watch, nil)
+            return nil
+        end
+
+        local current, current_count = set, count
+        set = 1 - set
+        count = nil
+        local rows
+        if convert then
+            rows = conn_call(self, 'cursor_push_batch', current, current_count)
+        end
+        if readahead then
+            pending = true
+            fiber.create(function(next_set)
+                prefetch:put({pcall(conn_call, self, 'cursor_fetch_batch', next_set)})
+            end, set)
+        end
+        if convert then
+            return rows
+        end
+        return current, current_count
+    end
+end
+
+-- Iterate over rows of a select statement. Rows are fetched in batches
+-- into two define buffer sets: while lua consumes batch k the worker
+-- thread fetches batch k + 1 into the other set.
+local function conn_rows(self, sql, args, opts)
+    local next_batch = cursor_batches(self, sql, args, opts or {}, false, true)
+    local data, pos = {}, 0
+    local done = false
+
+    return function()
+        if done then
+            return nil
+        end
+        pos = pos + 1
+        if data[pos] ~= nil then
+            return data[pos]
+        end
+        local ok, rows = pcall(next_batch)
+        if not ok then
+            done = true
+            pcall(self.cursor_close, self)
+            return error(rows)
+        end
+        if rows == nil then
+            done = true
+            self:cursor_close()
+            return nil
+        end
+        data, pos = rows, 1
+        return data[1]
+    end
+end
+
+-- End of a stream. The consumer taking it closes the channel for the
+-- others, all messages put before it are taken by then.
+local stream_eof = {}
+
+-- A stream is not a fiber.channel: it wraps one to end the result with
+-- stream_eof and to report a producer failure once the batches put
+-- before it are taken, instead of a short result.
+local stream_mt = {
+    __index = {
+        get = function(self, timeout)
+            local state = self.state
+            if state.error ~= nil and self.channel:is_empty() then
+                self.channel:close()
+                return {error = state.error}
+            end
+            local msg = self.channel:get(timeout)
+            if msg == stream_eof then
+                self.channel:close()
+                return nil
+            end
+            if msg == nil and state.error ~= nil then
+                return {error = state.error}
+            end
+            return msg
+        end,
+        close = function(self)
+            ffi.gc(self.watch, nil)
+            self.channel:close()
+        end,
+        is_closed = function(self)
+            return self.channel:is_closed()
+        end,
+        count = function(self)
+            return self.channel:count()
+        end,
+    }
+}
+
+-- Stream batches of rows of a select statement. A fiber puts batches
+-- fetched with read-ahead and converted under the guard into a channel,
+-- blocking while it is full, so memory is bounded by channel_size
+-- batches whatever the count of consumers is. An error is passed as a
+-- {error = reason} message. The producer stops when the stream is
+-- closed or collected, or when it waits for room longer than the
+-- optional timeout, which consumers see as an error. The cursor is
+-- closed then.
+local function conn_stream(self, sql, args, opts)
+    opts = opts or {}
+    local timeout = opts.timeout
+    local next_batch = cursor_batches(self, sql, args, opts, false, true)
+    local out = fiber.channel(opts.channel_size or 4)
+    local state = {}
+    local stream = setmetatable({
+        channel = out,
+        state = state,
+        watch = ffi.gc(ffi.new('void *'), function()
+            out:close()
+        end),
+    }, stream_mt)
+
+    local function put(msg)
+        if out:put(msg, timeout) then
+            return true
+        end
+        if not out:is_closed() then
+            state.error = 'stream timed out'
+        end
+        return false
+    end
+
+    fiber.create(function()
+        local ok, err = pcall(function()
+            while true do
+                local rows = next_batch()
+                if rows == nil or not put(rows) then
+                    return
+                end
+            end
+        end)
+        pcall(self.cursor_close, self)
+        if out:is_closed() or state.error ~= nil then
+            return
+        end
+        if not ok and not put({error = err}) then
+            -- report the failure itself rather than the timeout
+            if state.error ~= nil then
+                state.error = err
+            end
+            return
+        end
+        put(stream_eof)
+    end)
+    return stream
+end
+
+-- Iterate over batches of a select statement as FFI views over the
+-- define buffers. A view is valid until the next one is requested.
+-- Numbers are read as doubles, LOB columns are not supported.
+local function conn_batches(self, sql, args, opts)
+    local next_batch = cursor_batches(self, sql, args, opts or {}, true)
+    local views = {}
+    local done = false
+
+    return function()
+        if done then
+            return nil
+        end
+        local ok, set, count = pcall(next_batch)
+        if not ok then
+            done = true
+            return error(set)
+        end
+        if set == nil then
+            done = true
+            self:cursor_close()
+            return nil
+        end
+        local batch_view = views[set]
+        if batch_view == nil then
+            local status, msg, columns = self.conn:cursor_view(set)
+            if status ~= 0 then
+                conn_error(self, status, msg)
+                done = true
+                pcall(self.cursor_close, self)
+                return error(msg)
+            end
+            batch_view = view.create(columns)
+            views[set] = batch_view
+        end
+        batch_view.count = count
+        return batch_view
+    end
+end
+
+-- Turn a direct load source into an iterator triple. The source is a
+-- table of rows, a function returning the next row or nil, or a space
+-- or an index yielding tuples.
+local function load_source(source)
+    if type(source) == 'function' then
+        return function()
+            local row = source()
+            if row ~= nil then
+                return true, row
+            end
+        end
+    end
+    if type(source) == 'table' and type(source.pairs) == 'function' then
+        return source:pairs()
+    end
+    return ipairs(source)
+end
+
+-- Load rows into a table through the direct path interface. Rows are
+-- collected into chunks which are converted in C and loaded by the
+-- worker thread. The load is aborted on any error.
+local function conn_direct_load(self, table_name, columns, source, opts)
+    opts = opts or {}
+    local chunk = conn_call(self, 'dirpath_open', table_name, columns,
+                            opts.chunk or 1000, opts.date_format)
+    local rows, count, total = {}, 0, 0
+    local ok, err = pcall(function()
+        for _, row in load_source(source) do
+            count = count + 1
+            rows[count] = row
+            if count == chunk then
+                total = total + conn_call(self, 'dirpath_load', rows, count)
+                count = 0
+            end
+        end
+        if count > 0 then
+            total = total + conn_call(self, 'dirpath_load', rows, count)
+        end
+        conn_call(self, 'dirpath_finish')
+    end)
+    if not ok then
+        pcall(conn_call, self, 'dirpath_abort')
+        return error(err)
+    end
+    return total
+end
+
+-- Write rows of a select statement to a file. Batches are fetched,
+-- encoded and written by the worker thread in one job, no lua values
+-- are created. Returns count of written rows.
+local function conn_export(self, sql, args, path, opts)
+    opts = opts or {}
+    local trace = trace_start(self, sql, args)
+    cursor_open(self, sql, args, trace, opts.batch or 1000, false, 1)
+    local ok, res = pcall(conn_call, self, 'cursor_export', path,
+                          opts.format or 'csv')
+    pcall(self.cursor_close, self)
+    if not ok then
+        return error(res)
+    end
+    return res
+end
+
+-- Prepare a statement for repeated execution on the connection. The
+-- statement keeps its binds and define buffers between executions.
+local function conn_prepare(self, sql)
+    if not self.usable then
+        if self.raise then
+            return error('Connection is not usable')
+        end
+        return nil, 'Connection is not usable'
+    end
+    if not conn_lock(self) then
+        self.queue:put(false)
+        if self.raise then
+            return error('Connection is broken')
+        end
+        return nil, 'Connection is broken'
+    end
+    local status, msg, stmt = self.conn:prepare(sql)
+    if status ~= 0 then
+        self.queue:put(conn_error(self, status, msg))
+        if self.raise then
+            return error(msg)
+        end
+        return nil, msg
+    end
+    self.queue:put(true)
+    return setmetatable({conn = self, stmt = stmt, sql = sql}, stmt_mt)
+end
+
+stmt_mt = {
+    __index = {
+        -- Returns the same as conn:execute. Parameters should have the
+        -- names or positions of the first execution.
+        execute = function(self, args, opts)
+            local conn = self.conn
+            if self.stmt == nil then
+                if conn.raise then
+                    return error('Statement is closed')
+                end
+                return nil, nil, false, 'Statement is closed'
+            end
+            local trace = trace_start(conn, self.sql, args)
+            if not conn.usable then
+                if conn.raise then
+                    return error('Connection is not usable')
+                end
+                return nil, nil, false, 'Connection is not usable'
+            end
+            if not conn_lock(conn) then
+                conn.queue:put(false)
+                if conn.raise then
+                    return error('Connection is broken')
+                end
+                return nil, nil, false, 'Connection is broken'
+            end
+            local status, msg, data, output =
+                conn.conn:stmt_execute(self.stmt, args or {},
+                                       conn_autocommit(conn, opts))
+            trace_finish(conn, trace, status ~= 0)
+            if status ~= 0 then
+                conn.queue:put(conn_error(conn, status, msg))
+                if conn.raise then
+                    return error(msg)
+                end
+                return nil, nil, false, msg
+            end
+            conn.queue:put(true)
+            return data, output, true, msg
+        end,
+        close = function(self)
+            if self.stmt == nil then
+                return true
+            end
+            local stmt = self.stmt
+            self.stmt = nil
+            -- the driver frees statements of a closed connection itself
+            if self.conn.usable then
+                pcall(conn_call, self.conn, 'stmt_close', stmt)
+            end
+            return true
+        end,
+    }
+}
+
 conn_mt = {
     __index = {
-        execute = function(self, sql, args)
+        execute = function(self, sql, args, opts)
+            local trace = trace_start(self, sql, args)
             if not self.usable then
                 if self.raise then
                     return error('Connection is not usable')
                 end
                 return nil, nil, false, 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
                 end
                 return nil, nil, false, 'Connection is broken'
             end
-            local status, msg, data, output = self.conn:execute(sql, args or {})
+            -- a closed or broken connection does not serve cached results
+            local result_cache = opts ~= nil and opts.cache and self.cache
+            if result_cache then
+                local data = result_cache:get(sql, args)
+                if data ~= nil then
+                    self.queue:put(true)
+                    return data, nil, true
+                end
+            end
+            local status, msg, data, output = self.conn:execute(sql, args or {},
+                                                                conn_autocommit(self, opts))
+            trace_finish(self, trace, status ~= 0)
             if status ~= 0 then
-                self.queue:put(status > 0)
+                self.queue:put(conn_error(self, status, msg))
                 if self.raise then
                     return error(msg)
                 end
                 return nil, nil, false, msg
             end
             self.queue:put(true)
+            if result_cache and data ~= nil then
+                result_cache:put(sql, args, data, opts)
+            end
             return data, output, true, msg
         end,
+        execute_array = function(self, sql, rows, opts)
+            local trace = trace_start(self, sql, rows)
+            if not self.usable then
+                if self.raise then
+                    return error('Connection is not usable')
+                end
+                return nil, false, 'Connection is not usable'
+            end
+            if not conn_lock(self) then
+                self.queue:put(false)
+                if self.raise then
+                    return error('Connection is broken')
+                end
+                return nil, false, 'Connection is broken'
+            end
+            local status, msg, count = self.conn:execute_array(sql, rows, #rows,
+                                                               conn_autocommit(self, opts))
+            trace_finish(self, trace, status ~= 0)
+            if status ~= 0 then
+                self.queue:put(conn_error(self, status, msg))
+                if self.raise then
+                    return error(msg)
+                end
+                return nil, false, msg
+            end
+            self.queue:put(true)
+            return count, true, msg
+        end,
+        -- Run a list of {sql, binds} statements in one worker thread job,
+        -- stopping at the first error. A transactional batch is committed
+        -- at the end or rolled back on error.
+        execute_batch = function(self, statements, opts)
+            if not self.usable then
+                if self.raise then
+                    return error('Connection is not usable')
+                end
+                return nil, false, 'Connection is not usable'
+            end
+            if not conn_lock(self) then
+                self.queue:put(false)
+                if self.raise then
+                    return error('Connection is broken')
+                end
+                return nil, false, 'Connection is broken'
+            end
+            local transactional = opts ~= nil and opts.transactional or false
+            local status, msg, results = self.conn:execute_batch(statements,
+                                                                 transactional)
+            if status ~= 0 then
+                self.queue:put(conn_error(self, status, msg))
+                if self.raise then
+                    return error(msg)
+                end
+                return nil, false, msg
+            end
+            self.queue:put(true)
+            return results, true, msg
+        end,
         cursor_open = function(self, sql, args)
+            local trace = trace_start(self, sql, args)
             if not self.usable then
                 if self.raise then
                     return error('Connection is not usable')
                 end
                 return false, 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
@@ -94,12 +754,14 @@ conn_mt = {
             end
             local status, msg = self.conn:cursor_open(sql, args or {})
             if status ~= 0 then
-                self.queue:put(status > 0)
+                trace_finish(self, trace, true)
+                self.queue:put(conn_error(self, status, msg))
                 if self.raise then
                     return error(msg)
                 end
                 return false, msg
             end
+            cursor_opened(self, trace)
             self.queue:put(true)
             return true, msg
         end,
@@ -110,7 +772,7 @@ conn_mt = {
                 end
                 return nil, false, 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
@@ -119,7 +781,7 @@ conn_mt = {
             end
             local status, msg, data = self.conn:cursor_fetch()
             if status ~= 0 then
-                self.queue:put(status > 0)
+                self.queue:put(conn_error(self, status, msg))
                 if self.raise then
                     return error(msg)
                 end
@@ -135,7 +797,7 @@ conn_mt = {
                 end
                 return 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
@@ -143,9 +805,19 @@ conn_mt = {
                 return false, 'Connection is broken'
             end
             self.conn:cursor_close()
+            self.cursor_id = nil
+            trace_finish(self, self.trace)
+            self.trace = nil
             self.queue:put(true)
             return true
         end,
+        rows = conn_rows,
+        batches = conn_batches,
+        stream = conn_stream,
+        direct_load = conn_direct_load,
+        export = conn_export,
+        stat = conn_stat,
+        prepare = conn_prepare,
         begin = function(self)
             if not self.usable then
                 if self.raise then
@@ -153,7 +825,7 @@ conn_mt = {
                 end
                 return false, 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
@@ -164,12 +836,10 @@ conn_mt = {
             return true
         end,
         commit = function(self)
-            local _, _, ret, msg = self:execute('COMMIT')
-            return ret, msg
+            return conn_trans(self, 'commit')
         end,
         rollback = function(self)
-            _, _, ret, msg = self:execute('ROLLBACK')
-            return ret, msg
+            return conn_trans(self, 'rollback')
         end,
         ping = function(self)
             local status, data, msg = pcall(self.execute, self, 'SELECT 1 AS code FROM dual')
@@ -182,7 +852,7 @@ conn_mt = {
                 end
                 return false, 'Connection is not usable'
             end
-            if not self.queue:get() then
+            if not conn_lock(self) then
                 self.queue:put(false)
                 if self.raise then
                     return error('Connection is broken')
@@ -201,6 +871,15 @@ local function build_conn_string(opts)
     return string.format("%s:%s/%s", opts.host, opts.port, opts.db), opts.user, opts.pass
 end
 
+-- Result cache is either shared by passing a cache object or created
+-- from the size and ttl options.
+local function make_cache(opts)
+    if opts == nil or cache.is_cache(opts) then
+        return opts
+    end
+    return cache.create(opts)
+end
+
 -- Create connection pool. Accepts ora connection params (host, port, user,
 -- password, dbname) and size.
 local function pool_create(opts)
@@ -208,6 +887,7 @@ local function pool_create(opts)
     local conn_string, user, pass = build_conn_string(opts)
     opts.size = opts.size or 1
     local queue = fiber.channel(opts.size)
+    local conns = setmetatable({}, {__mode = 'k'})
 
     for i = 1, opts.size do
         local status, conn = driver.connect(conn_string, user, pass)
@@ -221,9 +901,10 @@ local function pool_create(opts)
             end
         end
         queue:put(conn)
+        conns[conn] = true
     end
 
-    return setmetatable({
+    local pool = setmetatable({
         -- connection variables
         host        = opts.host,
         port        = opts.port,
@@ -237,7 +918,16 @@ local function pool_create(opts)
         queue       = queue,
         usable      = true,
         raise       = opts.raise or false,
+        cache       = make_cache(opts.cache),
+        slow_query  = opts.slow_query,
+        log_binds   = opts.log_binds,
+        autocommit  = opts.autocommit,
+        conns       = conns,
+        name        = opts.name or conn_string,
+        stats       = {checkouts = 0, wait_time = 0, in_use = 0, waiting = 0},
     }, pool_mt)
+    metrics.add_pool(pool)
+    return pool
 end
 
 -- Close pool
@@ -264,14 +954,314 @@ local function pool_put(self, conn)
     if not self.usable then
         return error('Pool is not usable')
     end
+    self.stats.in_use = self.stats.in_use - 1
     self.queue:put(conn_put(conn))
 end
 
+-- Pool statistics with the counters of the pooled connections summed.
+-- Closed connections are skipped.
+local function pool_stat(self)
+    local res = {
+        size = self.size,
+        checkouts = self.stats.checkouts,
+        wait_time = self.stats.wait_time,
+        in_use = self.stats.in_use,
+        waiting = self.stats.waiting,
+        guard_wait_time = 0,
+        errors = {},
+    }
+    for ora_conn in pairs(self.conns) do
+        local ok, stat = pcall(ora_conn.stat, ora_conn)
+        if ok then
+            for name, value in pairs(stat) do
+                res[name] = (res[name] or 0) + value
+            end
+        end
+        local stats = conn_stats[ora_conn]
+        if stats ~= nil then
+            res.guard_wait_time = res.guard_wait_time + stats.guard_wait_time
+            for code, count in pairs(stats.errors) do
+                res.errors[code] = (res.errors[code] or 0) + count
+            end
+        end
+    end
+    return res
+end
+
+-- Export a space or an index range to Oracle. The scan is split into
+-- batches which are executed as array DML and committed by `workers`
+-- fibers, each holding its own pool connection, while the scanning
+-- fiber collects the next batch.
+local function pool_export_space(self, space, sql, opts)
+    if not self.usable then
+        return error('Pool is not usable')
+    end
+    opts = opts or {}
+    local workers = opts.workers or self.size
+    local batch = opts.batch or 1000
+    local index = space.index[opts.index or 0]
+    local jobs = fiber.channel(1)
+    local done = fiber.channel(workers)
+    local stats = {rows = 0, batches = 0}
+    local failure
+    local start = clock.monotonic()
+
+    local function worker()
+        local ok, conn = pcall(pool_get, self)
+        if not ok then
+            failure = failure or conn
+            conn = nil
+        end
+        while true do
+            local rows = jobs:get()
+            if not rows then
+                break
+            end
+            if failure == nil then
+                local ok, err = pcall(function()
+                    conn_call(conn, 'execute_array', sql, rows, #rows, true)
+                end)
+                if ok then
+                    stats.rows = stats.rows + #rows
+                    stats.batches = stats.batches + 1
+                    stats.seconds = clock.monotonic() - start
+                    if opts.on_progress ~= nil then
+                        opts.on_progress(stats)
+                    end
+                else
+                    failure = failure or err
+                    pcall(conn_call, conn, 'execute', 'ROLLBACK', {})
+                end
+            end
+        end
+        if conn ~= nil then
+            pool_put(self, conn)
+        end
+        done:put(true)
+    end
+
+    for _ = 1, workers do
+        fiber.create(worker)
+    end
+
+    local rows = {}
+    for _, tuple in index:pairs(opts.key, {iterator = opts.iterator}) do
+        if failure ~= nil then
+            break
+        end
+        rows[#rows + 1] = opts.transform and opts.transform(tuple) or tuple
+        if #rows == batch then
+            jobs:put(rows)
+            rows = {}
+        end
+    end
+    if #rows > 0 and failure == nil then
+        jobs:put(rows)
+    end
+    for _ = 1, workers do
+        jobs:put(false)
+    end
+    for _ = 1, workers do
+        done:get()
+    end
+
+    stats.seconds = clock.monotonic() - start
+    stats.rate = stats.seconds > 0 and stats.rows / stats.seconds or 0
+    log.info('ora: exported %d rows of %s in %d batches, %.3f s, %.0f rows/s',
+             stats.rows, space.name, stats.batches, stats.seconds, stats.rate)
+    if failure ~= nil then
+        return error(failure)
+    end
+    return stats
+end
+
+-- Build the statement of one partition of a parallel select. The
+-- template may have {partition} and {as_of} markers, without the first
+-- one the template is wrapped into a subquery filtered by the hash.
+local function partition_sql(template, predicate, as_of)
+    local sql = template:gsub('{as_of}', as_of)
+    if sql:find('{partition}', 1, true) then
+        return (sql:gsub('{partition}', predicate))
+    end
+    return string.format('SELECT * FROM (%s) WHERE %s', sql, predicate)
+end
+
+-- Split a parallel select into partitions: predicates and parameters
+-- for every one of them.
+local function select_partitions(self, template, opts, as_of, params)
+    local count = opts.partitions or self.size
+    local by = opts.by or 'rowid'
+    local parts = {}
+    local column = by:match('^hash%((.+)%)$')
+    if column ~= nil then
+        for i = 0, count - 1 do
+            local args = table.copy(params)
+            args.ORA_PART = i
+            parts[#parts + 1] = {
+                sql = partition_sql(template, string.format(
+                    'ORA_HASH(%s, %d) = :ORA_PART', column, count - 1), as_of),
+                args = args,
+            }
+        end
+        return parts
+    end
+    if by ~= 'rowid' then
+        return error('Partitioning should be rowid or hash(column)')
+    end
+    if opts.table == nil or not template:find('{partition}', 1, true) then
+        return error('Rowid partitioning needs table option and {partition} marker')
+    end
+    -- rowid ranges of equal row counts, the way DBMS_PARALLEL_EXECUTE
+    -- chunks a table, but without creating a task
+    local conn = pool_get(self)
+    local ok, ranges = pcall(conn_call, conn, 'execute', string.format(
+        'SELECT ROWIDTOCHAR(MIN(rid)) AS LO, ROWIDTOCHAR(MAX(rid)) AS HI ' ..
+        'FROM (SELECT ROWID AS rid, NTILE(%d) OVER (ORDER BY ROWID) AS nt ' ..
+        'FROM %s %s) GROUP BY nt', count, opts.table, as_of),
+        params.ORA_SCN and {ORA_SCN = params.ORA_SCN} or {})
+    pool_put(self, conn)
+    if not ok then
+        return error(ranges)
+    end
+    for _, range in ipairs(ranges) do
+        local args = table.copy(params)
+        args.ORA_LO = range.LO
+        args.ORA_HI = range.HI
+        parts[#parts + 1] = {
+            sql = partition_sql(template,
+                'ROWID BETWEEN CHARTOROWID(:ORA_LO) AND CHARTOROWID(:ORA_HI)',
+                as_of),
+            args = args,
+        }
+    end
+    return parts
+end
+
+-- Run a select split into disjoint partitions concurrently, one pool
+-- connection per partition. Rows are either written into a space or
+-- streamed through the returned iterator.
+local function pool_parallel_select(self, template, opts)
+    if not self.usable then
+        return error('Pool is not usable')
+    end
+    opts = opts or {}
+    local params = table.copy(opts.params or {})
+    local as_of = ''
+    local scn = opts.scn
+    if opts.snapshot and scn == nil then
+        local conn = pool_get(self)
+        local ok, res = pcall(conn_call, conn, 'execute',
+            'SELECT TO_CHAR(DBMS_FLASHBACK.GET_SYSTEM_CHANGE_NUMBER) AS SCN FROM dual', {})
+        pool_put(self, conn)
+        if not ok then
+            return error(res)
+        end
+        scn = res[1].SCN
+    end
+    if scn ~= nil then
+        as_of = 'AS OF SCN :ORA_SCN'
+        params.ORA_SCN = {type = 'int64', value = scn}
+    end
+
+    local parts = select_partitions(self, template, opts, as_of, params)
+    local space = opts.space
+    local out = fiber.channel(opts.buffer or 1000)
+    local stats = {rows = 0, partitions = #parts}
+    local start = clock.monotonic()
+    local done = {}
+    local failure_mt = {}
+    local live = #parts
+    local finished = fiber.cond()
+
+    local function partition(part)
+        local conn
+        local ok, err = pcall(function()
+            conn = pool_get(self)
+            for row in conn_rows(conn, part.sql, part.args, {batch = opts.batch}) do
+                if space ~= nil then
+                    space:replace(opts.transform and opts.transform(row) or
+                                  space:frommap(row))
+                    stats.rows = stats.rows + 1
+                elseif not out:put(row) then
+                    -- the consumer has gone, stop the cursor
+                    conn:cursor_close()
+                    break
+                end
+            end
+        end)
+        if conn ~= nil then
+            if not ok then
+                pcall(conn.cursor_close, conn)
+            end
+            pcall(pool_put, self, conn)
+        end
+        out:put(ok and done or setmetatable({error = err}, failure_mt))
+        live = live - 1
+        finished:broadcast()
+    end
+
+    for _, part in ipairs(parts) do
+        fiber.create(partition, part)
+    end
+
+    local running = #parts
+    local function next_row()
+        while running > 0 do
+            local row = out:get()
+            if row == nil then
+                -- closed by the consumer
+                running = 0
+            elseif row == done then
+                running = running - 1
+            elseif getmetatable(row) == failure_mt then
+                running = 0
+                out:close()
+                return error(row.error)
+            else
+                return row
+            end
+        end
+        return nil
+    end
+
+    if space == nil then
+        -- Partitions block on the full channel until the consumer takes
+        -- rows. Closing it, or collecting the iterator, stops them and
+        -- returns their connections.
+        local watch = ffi.gc(ffi.new('void *'), function()
+            out:close()
+        end)
+        return setmetatable({
+            close = function()
+                ffi.gc(watch, nil)
+                running = 0
+                out:close()
+                while live > 0 do
+                    finished:wait()
+                end
+            end,
+        }, {
+            __call = function()
+                return next_row()
+            end,
+        })
+    end
+    next_row()
+    stats.seconds = clock.monotonic() - start
+    stats.rate = stats.seconds > 0 and stats.rows / stats.seconds or 0
+    log.info('ora: loaded %d rows into %s from %d partitions, %.3f s, %.0f rows/s',
+             stats.rows, space.name, stats.partitions, stats.seconds, stats.rate)
+    return stats
+end
+
 pool_mt = {
     __index = {
         get = pool_get;
         put = pool_put;
         close = pool_close;
+        stat = pool_stat;
+        export_space = pool_export_space;
+        parallel_select = pool_parallel_select;
     }
 }
 
@@ -285,10 +1275,18 @@ local function connect(opts)
     if status < 0 then
         return error(ora_conn)
     end
-    return conn_create(ora_conn, opts.raise or false)
+    return conn_create(ora_conn, {
+        raise = opts.raise or false,
+        cache = make_cache(opts.cache),
+        slow_query = opts.slow_query,
+        log_binds = opts.log_binds,
+        autocommit = opts.autocommit,
+    })
 end
 
 return {
     connect = connect;
     pool_create = pool_create;
+    cache_create = cache.create;
+    metrics_enable = metrics.enable;
 }
@@ -0,0 +1,120 @@
+-- metrics.lua (internal file)
+--
+-- Collectors of the metrics module. Statements are labelled by their
+-- fingerprint, the text with literals replaced by '?', so that the
+-- tail latency of every kind of query is seen separately. Only `top`
+-- fingerprints get their own label, the rest are counted as 'other'.
+-- Pools report idle, in-use and waiting counts as gauges.
+
+local pools = setmetatable({}, {__mode = 'k'})
+local collectors
+
+-- fingerprints of recently seen statement texts
+local texts, text_count = {}, 0
+local TEXT_CACHE_SIZE = 1024
+
+local function normalize(sql)
+    -- a quote doubled inside a literal splits it into adjacent ones
+    return (sql:gsub("'[^']*'", '?')
+               :gsub('%?%?+', '?')
+               :gsub('%f[%w_:]%d+%.?%d*', '?')
+               :gsub('%(%s*%?[%s,%?]*%)', '(?)')
+               :gsub('%s+', ' ')
+               :gsub('^ ', '')
+               :gsub(' $', '')
+               :upper())
+end
+
+local function fingerprint(sql)
+    local fp = texts[sql]
+    if fp ~= nil then
+        return fp
+    end
+    fp = normalize(sql)
+    local known = collectors.fingerprints
+    if known[fp] == nil then
+        if collectors.count >= collectors.top then
+            fp = 'other'
+        else
+            known[fp] = true
+            collectors.count = collectors.count + 1
+        end
+    end
+    if text_count >= TEXT_CACHE_SIZE then
+        texts, text_count = {}, 0
+    end
+    texts[sql] = fp
+    text_count = text_count + 1
+    return fp
+end
+
+local function update_pools()
+    for pool in pairs(pools) do
+        local labels = {pool = pool.name}
+        local stats = pool.stats
+        collectors.idle:set(pool.queue:count(), labels)
+        collectors.in_use:set(stats.in_use, labels)
+        collectors.waiting:set(stats.waiting, labels)
+    end
+end
+
+-- Create the collectors. Options are `top`, the count of fingerprints
+-- with their own label, and `quantiles` of the latency summary.
+local function metrics_enable(opts)
+    if collectors ~= nil then
+        return
+    end
+    opts = opts or {}
+    local metrics = require('metrics')
+    local objectives = {}
+    for _, q in ipairs(opts.quantiles or {0.5, 0.99, 0.999}) do
+        objectives[q] = math.min(0.01, (1 - q) / 10)
+    end
+    collectors = {
+        top = opts.top or 100,
+        count = 0,
+        fingerprints = {},
+        latency = metrics.summary('ora_query_duration',
+            'Statement latency in seconds by fingerprint', objectives,
+            {max_age_time = opts.max_age or 60, age_buckets_count = 5}),
+        rows = metrics.counter('ora_query_rows',
+            'Rows fetched by fingerprint'),
+        bytes = metrics.counter('ora_query_bytes',
+            'Bytes fetched by fingerprint'),
+        errors = metrics.counter('ora_query_errors',
+            'Failed statements by fingerprint'),
+        idle = metrics.gauge('ora_pool_idle', 'Idle pool connections'),
+        in_use = metrics.gauge('ora_pool_in_use', 'Pool connections in use'),
+        waiting = metrics.gauge('ora_pool_waiting',
+            'Fibers waiting for a pool connection'),
+    }
+    metrics.register_callback(update_pools)
+end
+
+local function metrics_enabled()
+    return collectors ~= nil
+end
+
+-- Record a finished statement, timing is the one of the driver.
+local function metrics_observe(sql, elapsed, timing, failed)
+    local labels = {fingerprint = fingerprint(sql)}
+    collectors.latency:observe(elapsed, labels)
+    if failed then
+        collectors.errors:inc(1, labels)
+        return
+    end
+    collectors.rows:inc(timing.rows, labels)
+    collectors.bytes:inc(timing.bytes, labels)
+end
+
+local function metrics_add_pool(pool)
+    pools[pool] = true
+end
+
+return {
+    enable = metrics_enable;
+    enabled = metrics_enabled;
+    observe = metrics_observe;
+    add_pool = metrics_add_pool;
+    normalize = normalize;
+}
@@ -0,0 +1,279 @@
+#include "stmt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#undef PACKAGE_VERSION
+#include <module.h>
+
+#include "types.h"
+#include "bind.h"
+#include "define.h"
+#include "util.h"
+
+static const char ora_stmt_label[] = "__tnt_ora_stmt";
+
+/**
+ * Unlink the statement from the prepared ones of its connection
+ */
+static void
+ora_stmt_unlink(struct ora_conn_ctx *conn, struct ora_stmt *stmt)
+{
+	struct ora_stmt **link = &conn->stmts;
+	while (*link != stmt)
+		link = &(*link)->next;
+	*link = stmt->next;
+	stmt->next = NULL;
+}
+
+/**
+ * A statement could be collected while a coio call of its connection
+ * runs in a worker thread, and the OCI environment is not thread safe.
+ * No OCI call is made here: the state is moved to the pending list of
+ * the connection and released by ora_stmt_free_pending under the
+ * connection guard.
+ */
+static int
+lua_ora_stmt_gc(struct lua_State *L)
+{
+	struct ora_stmt *stmt =
+		(struct ora_stmt *)luaL_checkudata(L, 1, ora_stmt_label);
+	struct ora_conn_ctx *conn = stmt->conn;
+	if (conn == NULL)
+		return 0;
+
+	ora_stmt_unlink(conn, stmt);
+	struct ora_stmt *pending =
+		(struct ora_stmt *)malloc(sizeof(struct ora_stmt));
+	if (pending != NULL) {
+		*pending = *stmt;
+		pending->next = conn->stmts_pending;
+		conn->stmts_pending = pending;
+	} else {
+		/* the handle is freed with the environment then */
+		free(stmt->bind_names);
+		free(stmt->sql);
+	}
+	memset(stmt, 0, sizeof(*stmt));
+	return 0;
+}
+
+static int
+lua_ora_stmt_tostring(struct lua_State *L)
+{
+	struct ora_stmt *stmt =
+		(struct ora_stmt *)luaL_checkudata(L, 1, ora_stmt_label);
+	lua_pushfstring(L, "Oracle statement: %p", stmt);
+	return 1;
+}
+
+void
+ora_stmt_init(struct lua_State *L)
+{
+	static const struct luaL_Reg methods [] = {
+		{"__tostring",	 lua_ora_stmt_tostring},
+		{"__gc",	 lua_ora_stmt_gc},
+		{NULL, NULL}
+	};
+
+	luaL_newmetatable(L, ora_stmt_label);
+	luaL_register(L, NULL, methods);
+	lua_pushstring(L, ora_stmt_label);
+	lua_setfield(L, -2, "__metatable");
+	lua_pop(L, 1);
+}
+
+struct ora_stmt *
+ora_stmt_check(struct lua_State *L, int idx)
+{
+	struct ora_stmt *stmt =
+		(struct ora_stmt *)luaL_checkudata(L, idx, ora_stmt_label);
+	if (stmt == NULL || stmt->conn == NULL)
+		luaL_error(L, "Driver fatal error (closed statement "
+			   "or not a statement)");
+	return stmt;
+}
+
+/**
+ * Prepare a statement and push it. Statement type is read here, binds
+ * and defines are made by the first execution.
+ */
+int
+ora_stmt_prepare(struct lua_State *L, struct ora_conn_ctx *conn,
+		 const char *sql)
+{
+	sword errcode;
+	OCIStmt *stmthp = NULL;
+	ub2 stmt_type;
+
+	errcode = OCIHandleAlloc((dvoid *)conn->envhp, (dvoid **)&stmthp,
+				 OCI_HTYPE_STMT, (size_t)0, (dvoid **)0);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_stmt;
+
+	errcode = OCIStmtPrepare(stmthp, conn->errhp, (text *)sql,
+				 (ub4)strlen(sql),
+				 (ub4)OCI_NTV_SYNTAX, (ub4)OCI_DEFAULT);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_prepare;
+
+	errcode = OCIAttrGet(stmthp, OCI_HTYPE_STMT, (void *)&stmt_type,
+			     (ub4 *)0, (ub4)OCI_ATTR_STMT_TYPE,
+			     (OCIError *)conn->errhp);
+	if (!checkerror(errcode, conn->errhp, conn->message, sizeof(conn->message), &conn->info))
+		goto fail_prepare;
+
+	char *copy = strdup(sql);
+	if (copy == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not allocate %zu bytes", strlen(sql) + 1);
+		goto fail_prepare;
+	}
+
+	struct ora_stmt *stmt =
+		(struct ora_stmt *)lua_newuserdata(L, sizeof(struct ora_stmt));
+	memset(stmt, 0, sizeof(*stmt));
+	stmt->conn = conn;
+	stmt->sql = copy;
+	stmt->stmt_type = stmt_type;
+	stmt->stmthp = stmthp;
+	stmt->define_rows = 1;
+	stmt->define_sets = 1;
+	stmt->next = conn->stmts;
+	conn->stmts = stmt;
+	luaL_getmetatable(L, ora_stmt_label);
+	lua_setmetatable(L, -2);
+	++conn->stat.prepares;
+	return 0;
+
+fail_prepare:
+	(void) OCIHandleFree((dvoid *)stmthp, (ub4)OCI_HTYPE_STMT);
+
+fail_stmt:
+	return -1;
+}
+
+#define ORA_SWAP(type, a, b) do {		\
+	type tmp = (a);				\
+	(a) = (b);				\
+	(b) = tmp;				\
+} while (0)
+
+/**
+ * Exchange the statement state with the one of the connection. Called
+ * before and after each use of a prepared statement, the connection
+ * has no statement of its own then.
+ */
+void
+ora_stmt_swap(struct ora_conn_ctx *conn, struct ora_stmt *stmt)
+{
+	ORA_SWAP(OCIStmt *, conn->stmthp, stmt->stmthp);
+	ORA_SWAP(uint32_t, conn->bind_count, stmt->bind_count);
+	ORA_SWAP(uint32_t, conn->bind_capacity, stmt->bind_capacity);
+	ORA_SWAP(struct ora_bind *, conn->binds, stmt->binds);
+	ORA_SWAP(uint32_t, conn->define_count, stmt->define_count);
+	ORA_SWAP(struct ora_define *, conn->defines, stmt->defines);
+	ORA_SWAP(ub4, conn->define_rows, stmt->define_rows);
+	ORA_SWAP(int, conn->define_sets, stmt->define_sets);
+	ORA_SWAP(int, conn->define_set, stmt->define_set);
+	ORA_SWAP(bool, conn->define_lobs, stmt->define_lobs);
+	ORA_SWAP(bool, conn->define_view, stmt->define_view);
+	ORA_SWAP(bool, conn->define_arena, stmt->define_arena);
+	ORA_SWAP(size_t, conn->define_mark, stmt->define_mark);
+	ORA_SWAP(bool, conn->fetch_eof, stmt->fetch_eof);
+}
+
+#undef ORA_SWAP
+
+/**
+ * Copy placeholder names of the swapped in binds, they point into the
+ * params table of the first execution.
+ */
+int
+ora_stmt_keep_names(struct ora_conn_ctx *conn, struct ora_stmt *stmt)
+{
+	size_t size = 0;
+	for (uint32_t idx = 0; idx < conn->bind_count; ++idx)
+		size += conn->binds[idx].bind_name_len;
+	if (size == 0)
+		return 0;
+
+	char *names = (char *)malloc(size);
+	if (names == NULL) {
+		snprintf(conn->message, sizeof(conn->message),
+			 "could not allocate %zu bytes", size);
+		return -1;
+	}
+	char *pos = names;
+	for (uint32_t idx = 0; idx < conn->bind_count; ++idx) {
+		struct ora_bind *bind = conn->binds + idx;
+		if (bind->bind_name == NULL)
+			continue;
+		memcpy(pos, bind->bind_name, bind->bind_name_len);
+		bind->bind_name = pos;
+		pos += bind->bind_name_len;
+	}
+	free(stmt->bind_names);
+	stmt->bind_names = names;
+	return 0;
+}
+
+/**
+ * Release the statement handle, binds and defines, the statement is
+ * already unlinked. Called under the connection guard.
+ */
+static void
+ora_stmt_release(struct lua_State *L, struct ora_conn_ctx *conn,
+		 struct ora_stmt *stmt)
+{
+	ora_stmt_swap(conn, stmt);
+	if (conn->defines != NULL)
+		ora_free_defines(L, conn);
+	ora_destroy_binds(conn);
+	(void) OCIHandleFree((dvoid *)conn->stmthp, (ub4)OCI_HTYPE_STMT);
+	conn->stmthp = NULL;
+	ora_stmt_swap(conn, stmt);
+
+	free(stmt->bind_names);
+	stmt->bind_names = NULL;
+	free(stmt->sql);
+	stmt->sql = NULL;
+	stmt->conn = NULL;
+}
+
+/**
+ * Release the statement handle, binds and defines. The userdata stays
+ * until it is collected.
+ */
+void
+ora_stmt_free(struct lua_State *L, struct ora_stmt *stmt)
+{
+	struct ora_conn_ctx *conn = stmt->conn;
+	if (conn == NULL)
+		return;
+
+	ora_stmt_unlink(conn, stmt);
+	ora_stmt_release(L, conn, stmt);
+}
+
+/**
+ * Release statements collected since the last call
+ */
+void
+ora_stmt_free_pending(struct lua_State *L, struct ora_conn_ctx *conn)
+{
+	while (conn->stmts_pending != NULL) {
+		struct ora_stmt *stmt = conn->stmts_pending;
+		conn->stmts_pending = stmt->next;
+		ora_stmt_release(L, conn, stmt);
+		free(stmt);
+	}
+}
+
+void
+ora_stmt_free_all(struct lua_State *L, struct ora_conn_ctx *conn)
+{
+	ora_stmt_free_pending(L, conn);
+	while (conn->stmts != NULL)
+		ora_stmt_free(L, conn->stmts);
+}
@@ -0,0 +1,34 @@
+#ifndef ORA_STMT_H
+#define ORA_STMT_H
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "types.h"
+
+void
+ora_stmt_init(struct lua_State *L);
+
+struct ora_stmt *
+ora_stmt_check(struct lua_State *L, int idx);
+
+int
+ora_stmt_prepare(struct lua_State *L, struct ora_conn_ctx *conn,
+		 const char *sql);
+
+void
+ora_stmt_swap(struct ora_conn_ctx *conn, struct ora_stmt *stmt);
+
+int
+ora_stmt_keep_names(struct ora_conn_ctx *conn, struct ora_stmt *stmt);
+
+void
+ora_stmt_free(struct lua_State *L, struct ora_stmt *stmt);
+
+void
+ora_stmt_free_pending(struct lua_State *L, struct ora_conn_ctx *conn);
+
+void
+ora_stmt_free_all(struct lua_State *L, struct ora_conn_ctx *conn);
+
+#endif
@@ -6,12 +6,54 @@
 
 #include <oci.h>
 
+#include "arena.h"
+
 struct ora_conn_ctx;
 
+/**
+ * Runtime statistics of a connection, times are in seconds.
+ */
+struct ora_stat {
+	uint64_t executes;
+	uint64_t fetches;
+	uint64_t rows_fetched;
+	/* bytes of values converted to lua */
+	uint64_t bytes_fetched;
+	uint64_t lob_bytes;
+	uint64_t binds;
+	/* statements prepared and executions of prepared statements */
+	uint64_t prepares;
+	uint64_t prepared_executes;
+	uint64_t coio_calls;
+	/* queued in the coio thread pool */
+	double coio_wait_time;
+	/* inside OCI on worker threads */
+	double oci_time;
+	/* converting results to lua */
+	double convert_time;
+};
+
+/**
+ * Phase timings of the last statement, times are in seconds. Fetch and
+ * conversion of a cursor are accumulated until it is closed.
+ */
+struct ora_timing {
+	double prepare;
+	double bind;
+	double execute;
+	/* describe of the select list and define of its buffers */
+	double define;
+	double fetch;
+	double convert;
+	uint64_t rows;
+	uint64_t bytes;
+	uint32_t binds;
+};
+
 struct ora_bind_return {
 	union {
+		int64_t int64;
 		uint64_t uint64;
-		char *string;
 		OCINumber number;
 	};
 	ub4 rlen;
@@ -19,47 +61,173 @@ struct ora_bind_return {
 	ub2 ind;
 };
 
+/**
+ * Value of an array bind for one iteration. The type is the one the
+ * value was decoded as, before it is converted to the bind type.
+ */
+struct ora_bind_value {
+	union {
+		int64_t int64;
+		uint64_t uint64;
+		double real;
+		OCINumber number;
+		struct {
+			const char *value;
+			size_t len;
+		} string;
+	};
+	ub2 type;
+	sb2 ind;
+	/* length of a string element of the bound array */
+	ub2 len;
+};
+
 struct ora_bind {
 	OCIBind *bindhp;
+	/* placeholder name or position if name is NULL */
 	const char *bind_name;
 	size_t bind_name_len;
+	ub4 pos;
 	ub2 type;
 	union {
+		int64_t int64;
 		uint64_t uint64;
 		struct {
-			char *value;
+			/* points to lua string pinned by params table */
+			const char *value;
 			size_t len;
 		} string;
 		OCINumber number;
+		/* statement handle of a ref cursor, owned by the bind */
+		OCIStmt *cursor;
 	};
 	sb2 ind;
 	ub4 alen;
+	/* long form without value, could receive RETURNING INTO values */
+	bool output;
+	/* bound with OCI_DATA_AT_EXEC, values are passed in callbacks */
+	bool dynamic;
 
+	/*
+	 * Output arrays are kept in the bind slot between statements and
+	 * grow geometrically. Returned strings are stored contiguously,
+	 * alen bytes per row.
+	 */
+	ub4 max_rows;
 	struct ora_bind_return *returns;
-	ub2 rowsret;
+	ub4 returns_cap;
+	char *strings;
+	size_t strings_size;
+	ub4 rowsret;
+
+	/*
+	 * per iteration values of an array DML, kept as output arrays and
+	 * bound in place with OCIBindArrayOfStruct
+	 */
+	ub4 iters;
+	struct ora_bind_value *values;
+	ub4 values_cap;
 	struct ora_conn_ctx *conn;
 };
 
+/**
+ * Number of define buffer sets per statement. Two sets allow the
+ * worker thread to fetch the next batch while Lua converts the
+ * current one.
+ */
+#define ORA_DEFINE_SETS 2
+
+/**
+ * Rows per array fetch of result sets returned by PL/SQL: ref cursors
+ * and implicit results.
+ */
+#define ORA_RESULT_ROWS 100
+
+/**
+ * LONG RAW columns describe with no width; they are fetched into
+ * buffers of this size (the largest length a ub2 can report).
+ */
+#define ORA_LONG_RAW_SIZE 65535
+
+/**
+ * Define buffer set: arrays of values, indicators and lengths for
+ * define_rows rows of one column.
+ */
+struct ora_define_buf {
+	void *value;
+	sb2 *ind;
+	ub2 *len;
+};
+
 struct ora_define {
 	OCIDefine *defhp;
 	char *col_name;
 	ub4 col_name_len;
+	/* registry reference to the interned column name */
+	int name_ref;
 	ub2 col_width;
 	ub2 type;
 	ub4 char_semantics;
-	union {
-		double double64;
-		int64_t int64;
-		uint64_t uint64;
-		struct {
-			char *value;
-			size_t len;
-		} string;
-		OCINumber number;
-		OCIClobLocator *clob;
-		OCIBlobLocator *blob;
-	};
-	sb2 ind;
+	/* external type and size of one value in a buffer set */
+	ub2 dty;
+	ub4 value_size;
+	struct ora_define_buf bufs[ORA_DEFINE_SETS];
+};
+
+/**
+ * Direct path load context. Column values are passed to OCI as text,
+ * numbers are formatted into the scratch buffer.
+ */
+struct ora_dirpath {
+	OCIDirPathCtx *ctx;
+	OCIDirPathColArray *colarr;
+	OCIDirPathStream *stream;
+	ub2 col_count;
+	/* rows in the column array, the largest chunk to load at once */
+	ub4 rows;
+	char *scratch;
+	bool prepared;
+};
+
+/**
+ * Prepared statement. It owns the statement handle with its binds and
+ * defines, which are swapped into the connection while the statement
+ * is executed, so the code of plain statements works on them as is.
+ */
+struct ora_stmt {
+	/* NULL once the statement or its connection is closed */
+	struct ora_conn_ctx *conn;
+	/* statements prepared on the connection */
+	struct ora_stmt *next;
+	char *sql;
+	ub2 stmt_type;
+	/* binds are made by the first execution */
+	bool bound;
+	/* copies of placeholder names of the first execution */
+	char *bind_names;
+	OCIStmt *stmthp;
+	uint32_t bind_count;
+	uint32_t bind_capacity;
+	struct ora_bind *binds;
+	uint32_t define_count;
+	struct ora_define *defines;
+	ub4 define_rows;
+	int define_sets;
+	int define_set;
+	bool define_lobs;
+	bool define_view;
+	bool define_arena;
+	size_t define_mark;
+	bool fetch_eof;
+};
+
+/**
+ * Statement of a batch. Statements are prepared and bound in TX thread
+ * and executed one after another in a single worker thread job.
+ */
+struct ora_batch_item {
+	struct ora_stmt stmt;
+	ub4 exec_count;
 };
 
 /**
@@ -72,10 +240,38 @@ struct ora_conn_ctx {
 	OCISvcCtx *svchp;
 	OCIError *errhp;
 	OCIStmt *stmthp;
+	/* bind array is kept between statements and grows on demand */
 	uint32_t bind_count;
+	uint32_t bind_capacity;
 	struct ora_bind *binds;
 	uint32_t define_count;
 	struct ora_define *defines;
+	/* rows per define buffer set, count of sets and the bound one */
+	ub4 define_rows;
+	int define_sets;
+	int define_set;
+	/* cursor has LOB columns which are read on conversion */
+	bool define_lobs;
+	/*
+	 * buffers are read through FFI views: numbers are defined as
+	 * doubles and LOBs are not allowed
+	 */
+	bool define_view;
+	/* defines are allocated on the arena above define_mark */
+	bool define_arena;
+	size_t define_mark;
+	/* last fetch has reached the end of the cursor */
+	bool fetch_eof;
+	/* direct path load in progress */
+	struct ora_dirpath *dirpath;
+	/* prepared statements, freed with the connection */
+	struct ora_stmt *stmts;
+	/* statements collected by lua, freed under the connection guard */
+	struct ora_stmt *stmts_pending;
+	/* define and LOB buffers of the statement being executed */
+	struct ora_arena arena;
+	struct ora_stat stat;
+	struct ora_timing timing;
 	bool info;
 	char message[512];
 };
@@ -1,6 +1,9 @@
 #include "util.h"
 
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -70,3 +73,55 @@ checkerror(sword status, OCIError *errhp, char *msg, size_t msg_len, bool *info)
 	return false;
 }
 
+/**
+ * Check if a DML statement has RETURNING (or RETURN) INTO clause.
+ * String literals, quoted identifiers and comments are skipped.
+ */
+bool
+ora_sql_has_returning(const char *sql)
+{
+	const char *p = sql;
+	while (*p != '\0') {
+		if (*p == '\'' || *p == '"') {
+			char quote = *p++;
+			while (*p != '\0' && *p != quote)
+				++p;
+			if (*p != '\0')
+				++p;
+		} else if (p[0] == '-' && p[1] == '-') {
+			while (*p != '\0' && *p != '\n')
+				++p;
+		} else if (p[0] == '/' && p[1] == '*') {
+			p += 2;
+			while (*p != '\0' && !(p[0] == '*' && p[1] == '/'))
+				++p;
+			if (*p != '\0')
+				p += 2;
+		} else if (isalpha((unsigned char)*p) || *p == '_') {
+			const char *word = p;
+			while (isalnum((unsigned char)*p) || *p == '_' ||
+			       *p == '$' || *p == '#')
+				++p;
+			size_t len = p - word;
+			if ((len == strlen("RETURNING") &&
+			     strncasecmp(word, "RETURNING", len) == 0) ||
+			    (len == strlen("RETURN") &&
+			     strncasecmp(word, "RETURN", len) == 0))
+				return true;
+		} else {
+			++p;
+		}
+	}
+	return false;
+}
+
+/**
+ * Check if a statement type is a PL/SQL block or a procedure call
+ */
+bool
+ora_stmt_is_plsql(ub2 stmt_type)
+{
+	return stmt_type == OCI_STMT_BEGIN ||
+	       stmt_type == OCI_STMT_DECLARE ||
+	       stmt_type == OCI_STMT_CALL;
+}
@@ -19,6 +19,12 @@ safe_pushstring(struct lua_State *L, char *str);
 bool
 checkerror(sword status, OCIError *errhp, char *msg, size_t msg_len, bool *info);
 
+bool
+ora_sql_has_returning(const char *sql);
+
+bool
+ora_stmt_is_plsql(ub2 stmt_type);
+
 #define CHECK_AND_GOTO(STATUS, ERRHP, MSG, MSG_LEN, INFO, LABEL) \
 do {if (!checkerror(STATUS, ERRHP, MSG, MSG_LEN, INFO)) goto LABEL;} while (0)
 
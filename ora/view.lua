@@ -0,0 +1,110 @@
+-- view.lua (internal file)
+--
+-- FFI views over fetched batches. A view reads values straight from
+-- the define buffers of the driver, so traced loops could filter rows
+-- without creating tables or strings and copy out only what is kept.
+-- A view is valid until the next batch is requested.
+
+local ffi = require('ffi')
+
+ffi.cdef[[
+struct ora_column_view {
+    const char *value;
+    const int16_t *ind;
+    const uint16_t *len;
+    uint32_t size;
+    uint16_t dty;
+};
+]]
+
+-- external types of define buffers
+local SQLT_INT = 3
+local SQLT_FLT = 4
+local SQLT_UIN = 68
+
+local double_ptr = ffi.typeof('const double *')
+local int64_ptr = ffi.typeof('const int64_t *')
+local uint64_ptr = ffi.typeof('const uint64_t *')
+
+local view_mt
+
+-- Make a view of a define buffer set from the description returned by
+-- the driver. Columns are addressed by 1-based index.
+local function view_create(columns)
+    local cols = ffi.new('struct ora_column_view[?]', #columns + 1)
+    local index = {}
+    for i, column in ipairs(columns) do
+        cols[i].value = ffi.cast('const char *', column.value)
+        cols[i].ind = ffi.cast('const int16_t *', column.ind)
+        cols[i].len = ffi.cast('const uint16_t *', column.len)
+        cols[i].size = column.size
+        cols[i].dty = column.dty
+        index[column.name] = i
+    end
+    return setmetatable({
+        count = 0,
+        width = #columns,
+        columns = cols,
+        index = index,
+    }, view_mt)
+end
+
+local function view_column(self, name)
+    return self.index[name]
+end
+
+local function view_is_null(self, col, row)
+    return self.columns[col].ind[row - 1] == -1
+end
+
+-- Numbers are read in place, int64 and uint64 columns give cdata,
+-- text columns are converted with tonumber.
+local function view_number(self, col, row)
+    local c = self.columns[col]
+    row = row - 1
+    if c.ind[row] == -1 then
+        return nil
+    end
+    local p = c.value + c.size * row
+    if c.dty == SQLT_FLT then
+        return ffi.cast(double_ptr, p)[0]
+    elseif c.dty == SQLT_INT then
+        return ffi.cast(int64_ptr, p)[0]
+    elseif c.dty == SQLT_UIN then
+        return ffi.cast(uint64_ptr, p)[0]
+    end
+    return tonumber(ffi.string(p, c.len[row]))
+end
+
+-- Pointer to the value and its length, valid while the view is.
+local function view_slice(self, col, row)
+    local c = self.columns[col]
+    row = row - 1
+    if c.ind[row] == -1 then
+        return nil, 0
+    end
+    return c.value + c.size * row, c.len[row]
+end
+
+-- Copy a value out as a lua string.
+local function view_string(self, col, row)
+    local p, len = view_slice(self, col, row)
+    if p == nil then
+        return nil
+    end
+    return ffi.string(p, len)
+end
+
+view_mt = {
+    __index = {
+        column = view_column;
+        is_null = view_is_null;
+        number = view_number;
+        slice = view_slice;
+        string = view_string;
+    }
+}
+
+return {
+    create = view_create;
+}
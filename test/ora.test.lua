@@ -3,6 +3,7 @@ local tap = require('tap')
 
 local ora = require('ora')
 local fiber = require('fiber')
+local fio = require('fio')
 local os = require('os')
 
 local db_server = os.environ()['DBSERVER']
@@ -18,6 +19,20 @@ end
 local db_address = string.format("%s:%s", db_server, db_port)
 print("Running tests to '"..db_address.."'")
 
+-- spaces for export and parallel select tests, the log is read by the
+-- slow query test
+local box_dir = fio.tempdir()
+local log_path = fio.pathjoin(box_dir, 'tarantool.log')
+box.cfg{memtx_dir = box_dir, wal_dir = box_dir, vinyl_dir = box_dir,
+        wal_mode = 'none', log = log_path}
+
+local function read_log()
+    local file = io.open(log_path)
+    local text = file:read('*a')
+    file:close()
+    return text
+end
+
 local conn = ora.connect({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = true })
 local conn_no_raise = ora.connect({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = false })
 
@@ -140,12 +155,580 @@ END;]])
 
 end
 
+local function test_rows(t, c)
+    t:plan(5)
+
+    local _, _, ok = c:execute("create table test_rows (id number not null primary key, name varchar2(40))")
+    t:ok(ok, "create table")
+    for i = 1, 25 do
+        c:execute("insert into test_rows values (:ID, :NAME)", {['ID'] = i, ['NAME'] = tostring(i)})
+    end
+
+    local rows = {}
+    for row in c:rows("select * from test_rows order by ID", {}, {batch = 10}) do
+        table.insert(rows, row)
+    end
+    t:is(#rows, 25, "all rows iterated")
+    t:is_deeply(rows[25], {['ID'] = 25, ['NAME'] = '25'}, "last row")
+
+    local data = c:execute("select 1 as ID from dual")
+    t:is_deeply(data, {{['ID'] = 1}}, "cursor closed after iteration")
+
+    for row in c:rows("select * from test_rows order by ID", {}, {batch = 10}) do
+        if row.ID == 3 then
+            break
+        end
+    end
+    collectgarbage()
+    collectgarbage()
+    data = c:execute("select 2 as ID from dual")
+    t:is_deeply(data, {{['ID'] = 2}}, "abandoned cursor closed")
+    c:execute("drop table test_rows")
+end
+
+local function test_batches(t, c)
+    t:plan(4)
+
+    c:execute("create table test_batches (id number, name varchar2(10))")
+    local rows = {}
+    for i = 1, 250 do
+        rows[i] = {i, i % 5 == 0 and 'n' .. i or nil}
+    end
+    -- the first row {1, nil} has one value for two placeholders
+    t:is(c:execute_array("insert into test_batches values (:1, :2)", rows), 250,
+        "NULL in the first row bound")
+
+    local count, sum, names = 0, 0, 0
+    for batch in c:batches("select id, name from test_batches", {}, {batch = 100}) do
+        local id, name = batch:column('ID'), batch:column('NAME')
+        for row = 1, batch.count do
+            count = count + 1
+            sum = sum + batch:number(id, row)
+            if not batch:is_null(name, row) then
+                names = names + 1
+            end
+        end
+    end
+    t:is(count, 250, "all rows viewed")
+    t:is(sum, 31375, "numbers read in place")
+    t:is(names, 50, "NULL indicators read")
+    c:execute("drop table test_batches")
+end
+
+local function test_binds(t, c)
+    t:plan(8)
+
+    local _, _, ok = c:execute("create table test_binds (id number not null primary key, name varchar2(40))")
+    t:ok(ok, "create table")
+
+    _, _, ok = c:execute("insert into test_binds values (:1, :2)", {1, "one"})
+    t:ok(ok, "positional insert")
+    t:is_deeply(c:execute("select * from test_binds where ID = :1", {1}),
+        {{['ID'] = 1, ['NAME'] = 'one'}}, "positional select")
+
+    local id = 9007199254740993LL
+    _, _, ok = c:execute("insert into test_binds values (:ID, :NAME)", {ID = id, NAME = 'big'})
+    t:ok(ok, "int64 cdata insert")
+    t:is_deeply(c:execute("select to_char(ID) as ID from test_binds where NAME = 'big'"),
+        {{['ID'] = '9007199254740993'}}, "int64 precision kept")
+    t:is_deeply(c:execute("select NAME from test_binds where ID = :ID", {ID = {type = 'int64', value = '9007199254740993'}}),
+        {{['NAME'] = 'big'}}, "int64 descriptor")
+
+    t:is_deeply(c:execute("select utl_raw.cast_to_raw('abc') as R from dual"),
+        {{['R'] = 'abc'}}, "raw define")
+    t:is_deeply(c:execute("select :R as R from dual", {R = {type = 'raw', value = '\0\1\255'}}),
+        {{['R'] = '\0\1\255'}}, "raw bind")
+
+    c:execute("drop table test_binds")
+end
+
+local function test_direct_load(t, c)
+    t:plan(4)
+
+    local _, _, ok = c:execute("create table test_load (id number, name varchar2(40))")
+    t:ok(ok, "create table")
+
+    local n = 0
+    local busy
+    local count = c:direct_load('TEST_LOAD', {'ID', {name = 'NAME', size = 40}},
+        function()
+            n = n + 1
+            if n == 1500 then
+                -- the direct path context of the load is open here
+                busy = select(2, pcall(c.execute, c, "select 1 as ONE from dual"))
+            end
+            if n <= 2500 then
+                return {n, n % 2 == 0 and 'even' or nil}
+            end
+        end, {chunk = 1000})
+    t:is(count, 2500, "rows loaded")
+    t:ok(tostring(busy):match('direct path load in progress') ~= nil,
+        "statements rejected during the load")
+    t:is_deeply(c:execute("select count(*) as C, count(name) as N from test_load"),
+        {{['C'] = 2500, ['N'] = 1250}}, "rows visible after load")
+
+    c:execute("drop table test_load")
+end
+
+local function test_execute_array(t, c)
+    t:plan(4)
+
+    local _, _, ok = c:execute("create table test_array (id number, val number, name varchar2(40))")
+    t:ok(ok, "create table")
+
+    local rows = {}
+    for i = 1, 100 do
+        rows[i] = {i, i % 2 == 0 and i / 4 or i, i % 3 ~= 0 and 'name' .. i or nil}
+    end
+    t:is(c:execute_array("insert into test_array values (:1, :2, :3)", rows), 100,
+        "positional rows inserted")
+    t:is(c:execute_array("update test_array set name = :NAME where id = :ID",
+        {{ID = 1, NAME = 'first'}, {ID = 2, NAME = 'second'}}), 2, "named rows updated")
+    t:is_deeply(c:execute("select count(name) as N, sum(val) as S from test_array"),
+        {{['N'] = 67, ['S'] = 3137.5}}, "values stored")
+
+    c:execute("drop table test_array")
+end
+
+local function test_cache(t, c)
+    t:plan(7)
+
+    local cache = ora.cache_create({size = 1024, ttl = 60})
+    c.cache = cache
+    local sql = "select 1 as ONE from dual where 1 = :A or 2 = :B"
+    local data = c:execute(sql, {A = 1, B = 2}, {cache = true, tags = {'DUAL'}})
+    t:is_deeply(data, {{['ONE'] = 1}}, "result on miss")
+    t:is_deeply(c:execute(sql, {B = 2, A = 1}, {cache = true}), data, "result on hit")
+    t:is_deeply({cache:stat().hits, cache:stat().misses}, {1, 1}, "hit and miss counted")
+
+    cache:invalidate_tag('DUAL')
+    t:is(cache:stat().entries, 0, "invalidated by tag")
+
+    for i = 1, 100 do
+        cache:put('select ' .. i, {}, {{['N'] = string.rep('x', 100)}})
+    end
+    t:ok(cache:stat().bytes <= 1024, "byte budget kept")
+    t:ok(cache:stat().evictions > 0, "least recently used evicted")
+    c.cache = nil
+
+    local p = ora.pool_create({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = true, size = 1, cache = cache})
+    local pc = p:get()
+    pc:execute(sql, {A = 1, B = 2}, {cache = true})
+    p:put(pc)
+    local ok = pcall(pc.execute, pc, sql, {A = 1, B = 2}, {cache = true})
+    t:ok(not ok, "no cached result on a released connection")
+    p:close()
+end
+
+local function test_stat(t, c)
+    t:plan(6)
+
+    local before = c:stat()
+    c:execute("select 1 as ONE from dual where 1 = :A", {A = 1})
+    local after = c:stat()
+    c:execute("select 2 as TWO from dual")
+    t:is(c:stat().arena_size, after.arena_size, "define arena reused")
+    t:is(tonumber(after.executes - before.executes), 1, "execute counted")
+    t:ok(after.rows_fetched > before.rows_fetched, "fetched rows counted")
+    t:is(tonumber(after.binds - before.binds), 1, "bind counted")
+    t:ok(after.coio_calls > before.coio_calls, "worker thread calls counted")
+
+    -- earlier tests could have raised the same error on the connection
+    local errors = c:stat().errors['ORA-00942'] or 0
+    pcall(c.execute, c, "select * from no_such_table")
+    t:is(c:stat().errors['ORA-00942'] - errors, 1, "error counted by code")
+end
+
+local function test_slow_query(t, c)
+    t:plan(4)
+
+    c.slow_query = 0
+    local logged = #read_log()
+    local sql = "select level as N from dual connect by level <= :A"
+    c:execute(sql, {A = 10})
+    local text = read_log():sub(logged + 1)
+    t:ok(text:find('ora: slow statement', 1, true) ~= nil and
+         text:find('sql: ' .. sql, 1, true) ~= nil, "statement logged as slow")
+    t:ok(text:find('binds: redacted', 1, true) ~= nil, "binds redacted")
+    local timing = c.conn:timing()
+    t:is_deeply({timing.binds, timing.rows}, {1, 10}, "binds and rows recorded")
+    t:ok(timing.execute > 0 and timing.fetch > 0, "phases timed")
+    c.slow_query = nil
+end
+
+local function test_metrics(t, c)
+    t:plan(4)
+
+    local metrics = require('ora.metrics')
+    t:is(metrics.normalize("select *  from t1 where id = 42 and name = 'x''y' and\n" ..
+        "val in (1, 2.5, 3) and p = :1"),
+        "SELECT * FROM T1 WHERE ID = ? AND NAME = ? AND VAL IN (?) AND P = :1",
+        "literals stripped")
+    t:is(metrics.normalize("select 1 from dual"), metrics.normalize("SELECT 2\nFROM DUAL"),
+        "same fingerprint")
+
+    local ok, collectors = pcall(require, 'metrics')
+    if not ok then
+        t:skip('metrics module is not installed')
+        t:skip('metrics module is not installed')
+        return
+    end
+    ora.metrics_enable()
+    local function collect(label, value)
+        collectors.invoke_callbacks()
+        local res = {}
+        for _, obs in ipairs(collectors.collect()) do
+            if obs.label_pairs[label] == value then
+                res[obs.metric_name] = obs.value
+            end
+        end
+        return res
+    end
+
+    local p = ora.pool_create({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = true, size = 2, name = 'test_metrics'})
+    local pc = p:get()
+    local values = collect('pool', 'test_metrics')
+    t:is_deeply({values.ora_pool_idle, values.ora_pool_in_use, values.ora_pool_waiting},
+        {1, 1, 0}, "pool gauges")
+    p:put(pc)
+    p:close()
+
+    local sql = "select * from no_such_metrics_table"
+    pcall(function()
+        for _ in c:rows(sql) do
+        end
+    end)
+    values = collect('fingerprint', metrics.normalize(sql))
+    t:is(values.ora_query_errors, 1, "failed cursor open counted")
+end
+
+local function test_prepare(t, c)
+    t:plan(10)
+
+    local _, _, ok = c:execute("create table test_prepare (id number, name varchar2(40))")
+    t:ok(ok, "create table")
+
+    local before = c:stat()
+    local insert = c:prepare("insert into test_prepare values (:ID, :NAME)")
+    for i = 1, 10 do
+        insert:execute({ID = i, NAME = i % 2 == 0 and 'name' .. i or nil})
+    end
+    insert:close()
+    local after = c:stat()
+    t:is_deeply({tonumber(after.prepares - before.prepares),
+                 tonumber(after.prepared_executes - before.prepared_executes)},
+        {1, 10}, "prepared once, executed ten times")
+    t:is_deeply(c:execute("select count(*) as C, count(name) as N from test_prepare"),
+        {{C = 10, N = 5}}, "placeholder missing from the first call bound NULL")
+    local pair = c:prepare("select :A as A, :B as B from dual")
+    t:is_deeply(pair:execute({A = 1}), {{A = 1, B = ''}},
+        "placeholder missing from params bound NULL")
+    t:is_deeply(pair:execute({A = 2, B = 'b'}), {{A = 2, B = 'b'}},
+        "missing placeholder passed later")
+    pair:close()
+
+    local select = c:prepare("select name as NAME from test_prepare where id = :1")
+    t:is_deeply(select:execute({2}), {{['NAME'] = 'name2'}}, "first execution")
+    t:is_deeply(select:execute({4}), {{['NAME'] = 'name4'}}, "rebound execution")
+    t:is_deeply(select:execute({3}), {{['NAME'] = ''}}, "null value")
+    t:is_deeply(select:execute({42}), {}, "no rows")
+    select:close()
+
+    -- released by the next call under the connection guard
+    c:prepare("select * from test_prepare")
+    collectgarbage()
+    collectgarbage()
+    t:is_deeply(c:execute("select count(*) as C from test_prepare"), {{C = 10}},
+        "collected statement freed by the next call")
+
+    c:execute("drop table test_prepare")
+end
+
+local function test_result_sets(t, c)
+    t:plan(3)
+
+    local _, output = c:execute("begin open :C for select level as N from dual " ..
+        "connect by level <= 250; end;", {C = {type = 'cursor'}})
+    t:is(#output.C, 250, "ref cursor rows across array fetches")
+    t:is_deeply(output.C[250], {['N'] = 250}, "ref cursor row")
+
+    local data = c:execute([[
+        declare
+            c1 sys_refcursor;
+            c2 sys_refcursor;
+        begin
+            open c1 for select 1 as A from dual;
+            dbms_sql.return_result(c1);
+            open c2 for select 'two' as B from dual;
+            dbms_sql.return_result(c2);
+        end;]])
+    t:is_deeply(data, {{{['A'] = 1}}, {{['B'] = 'two'}}}, "implicit results")
+end
+
+local function test_autocommit(t, c, other)
+    t:plan(5)
+
+    c:execute("create table test_autocommit (id number)")
+    local count = "select count(*) as N from test_autocommit"
+
+    c:execute("insert into test_autocommit values (1)", {}, {autocommit = true})
+    t:is_deeply(other:execute(count), {{['N'] = 1}}, "committed with execute")
+
+    c:execute("insert into test_autocommit values (2)")
+    t:is_deeply(other:execute(count), {{['N'] = 1}}, "left open without autocommit")
+    t:ok(c:rollback(), "native rollback")
+    t:is_deeply(c:execute(count), {{['N'] = 1}}, "rolled back")
+
+    c:execute_array("insert into test_autocommit values (:1)", {{3}, {4}},
+                    {autocommit = true})
+    t:is_deeply(other:execute(count), {{['N'] = 3}}, "committed with execute_array")
+
+    c:execute("drop table test_autocommit")
+end
+
+local function test_execute_batch(t, c)
+    t:plan(5)
+
+    c:execute("create table test_batch (id number, name varchar2(40))")
+    local results = c:execute_batch({
+        {"insert into test_batch values (:1, :2)", {1, 'one'}},
+        {"update test_batch set name = :NAME where id = 1", {NAME = 'first'}},
+        {"select * from test_batch"},
+    }, {transactional = true})
+    t:is_deeply({results[1].count, results[2].count}, {1, 1}, "dml counts")
+    t:is_deeply(results[3].rows, {{['ID'] = 1, ['NAME'] = 'first'}},
+        "later statements see earlier ones")
+
+    -- uncommitted work before the batch
+    c:execute("insert into test_batch values (3, 'three')")
+    local ok, err = pcall(c.execute_batch, c, {
+        {"insert into test_batch values (:1, :2)", {2, 'two'}},
+        {"insert into no_such_table values (1)"},
+    }, {transactional = true})
+    t:ok(not ok and err:match('^statement 2: ') ~= nil, "failed statement reported")
+    t:ok(err:match('ORA%-00942') ~= nil, "error of the statement kept")
+    t:is_deeply(c:execute("select id as ID from test_batch order by id"),
+        {{['ID'] = 1}, {['ID'] = 3}},
+        "batch rolled back on error, earlier work kept")
+    c:rollback()
+
+    c:execute("drop table test_batch")
+end
+
+local function test_export(t, c)
+    t:plan(5)
+
+    local fio = require('fio')
+    local json = require('json')
+    local msgpack = require('msgpack')
+    local dir = fio.tempdir()
+    local sql = [[select level as ID, case when level = 2 then null
+                  else 'a,"' || level || '"' end as NAME
+                  from dual connect by level <= :N]]
+
+    local path = fio.pathjoin(dir, 'rows.csv')
+    t:is(c:export(sql, {N = 3}, path, {batch = 2}), 3, "rows counted")
+    local file = fio.open(path)
+    t:is(file:read(), 'ID,NAME\n1,"a,""1"""\n2,\n3,"a,""3"""\n', "csv")
+    file:close()
+
+    path = fio.pathjoin(dir, 'rows.jsonl')
+    c:export(sql, {N = 2}, path, {format = 'jsonl'})
+    file = fio.open(path)
+    local lines = {}
+    for line in file:read():gmatch('[^\n]+') do
+        table.insert(lines, json.decode(line))
+    end
+    file:close()
+    t:is_deeply(lines, {{ID = 1, NAME = 'a,"1"'}, {ID = 2, NAME = json.NULL}},
+        "json lines")
+
+    path = fio.pathjoin(dir, 'rows.msgpack')
+    c:export(sql, {N = 1}, path, {format = 'msgpack'})
+    file = fio.open(path)
+    t:is_deeply(msgpack.decode(file:read()), {ID = 1, NAME = 'a,"1"'}, "msgpack")
+    file:close()
+
+    t:ok(not pcall(c.export, c, sql, {N = 1}, path, {format = 'xml'}),
+        "unknown format rejected")
+    fio.rmtree(dir)
+end
+
+local function test_stream(t, c)
+    t:plan(6)
+
+    local sql = "select level as N from dual connect by level <= :N"
+    local before = c:stat()
+    local ch = c:stream(sql, {N = 1000}, {batch = 10, channel_size = 2})
+    -- without consumers the producer stops at the full channel: two
+    -- batches in it, one waiting for room and one read ahead
+    fiber.sleep(0.2)
+    t:ok(tonumber(c:stat().rows_fetched - before.rows_fetched) <= 40,
+        "producer runs ahead by channel_size batches")
+
+    local done = fiber.channel(3)
+    local count, sum = 0, 0
+    for _ = 1, 3 do
+        fiber.create(function()
+            while true do
+                local batch = ch:get()
+                if batch == nil then
+                    break
+                end
+                for _, row in ipairs(batch) do
+                    count = count + 1
+                    sum = sum + row.N
+                end
+                fiber.yield()
+            end
+            done:put(true)
+        end)
+    end
+    for _ = 1, 3 do
+        done:get()
+    end
+    t:is_deeply({count, sum}, {1000, 500500}, "all rows consumed once")
+    t:ok(ch:is_closed(), "closed at the end")
+
+    -- a consumer slower than the timeout gets an error, not a short result
+    ch = c:stream(sql, {N = 1000}, {batch = 10, channel_size = 2, timeout = 0.1})
+    fiber.sleep(0.3)
+    local taken, last = 0
+    while true do
+        last = ch:get()
+        if last == nil or last.error ~= nil then
+            break
+        end
+        taken = taken + #last
+    end
+    t:is_deeply({taken, last and last.error}, {20, 'stream timed out'},
+        "buffered batches then the timeout error")
+    t:is_deeply(c:execute("select 1 as ONE from dual"), {{ONE = 1}},
+        "cursor closed after the timeout")
+
+    c:stream(sql, {N = 1000}, {batch = 10, channel_size = 2})
+    collectgarbage()
+    collectgarbage()
+    fiber.sleep(0.1)
+    t:is_deeply(c:execute("select 1 as ONE from dual"), {{ONE = 1}},
+        "cursor closed when the stream is collected")
+end
+
+local function test_export_space(t)
+    t:plan(5)
+
+    local p = ora.pool_create({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = true, size = 2})
+    local space = box.schema.space.create('test_export_space', {temporary = true})
+    space:create_index('pk')
+    for i = 1, 2500 do
+        -- tuples without the second field bind NULL
+        space:insert(i % 4 == 1 and {i, 'n' .. i} or {i})
+    end
+    local c = p:get()
+    c:execute("create table test_export_space (id number, name varchar2(10))")
+    p:put(c)
+
+    local progress = 0
+    local stats = p:export_space(space, "insert into test_export_space values (:1, :2)",
+        {workers = 2, batch = 1000, on_progress = function() progress = progress + 1 end})
+    t:is_deeply({stats.rows, stats.batches, progress}, {2500, 3, 3}, "all batches exported")
+    c = p:get()
+    t:is_deeply(c:execute("select count(*) as N, count(name) as M from test_export_space"),
+        {{['N'] = 2500, ['M'] = 625}}, "rows stored")
+    p:put(c)
+
+    local ok = pcall(p.export_space, p, space,
+        "insert into test_export_space values (:1, :2, :3)", {batch = 1000})
+    t:ok(not ok, "error raised")
+    t:is(p:stat().in_use, 0, "connections returned")
+    c = p:get()
+    t:is_deeply(c:execute("select count(*) as N from test_export_space"),
+        {{['N'] = 2500}}, "failed batches rolled back")
+    c:execute("drop table test_export_space")
+    p:put(c)
+    space:drop()
+    p:close()
+end
+
+local function test_parallel_select(t)
+    t:plan(5)
+
+    local p = ora.pool_create({ host = db_server, port = tostring(db_port), user = 'SYSTEM', pass = 'tntPswd', db = 'tnt', raise = true, size = 3})
+    local c = p:get()
+    c:execute("create table test_parallel (id number, name varchar2(10))")
+    local rows = {}
+    for i = 1, 300 do
+        rows[i] = {i, 'n' .. i}
+    end
+    c:execute_array("insert into test_parallel values (:1, :2)", rows)
+    p:put(c)
+
+    local count, sum = 0, 0
+    for row in p:parallel_select("select * from test_parallel",
+                                 {by = 'hash(id)', buffer = 10}) do
+        count = count + 1
+        sum = sum + row.ID
+    end
+    t:is_deeply({count, sum}, {300, 45150}, "all partitions merged")
+
+    local iter = p:parallel_select("select * from test_parallel",
+                                   {by = 'hash(id)', buffer = 10, batch = 10})
+    for _ in iter do
+        break
+    end
+    iter:close()
+    t:is(p:stat().in_use, 0, "closed iterator returns connections")
+    c = p:get()
+    t:is_deeply(c:execute("select 1 as ID from dual"), {{['ID'] = 1}},
+        "no cursor left open")
+    p:put(c)
+
+    iter = p:parallel_select("select * from test_parallel",
+                             {by = 'hash(id)', buffer = 10, batch = 10})
+    iter()
+    iter = nil
+    collectgarbage()
+    collectgarbage()
+    local deadline = fiber.time() + 10
+    while p:stat().in_use > 0 and fiber.time() < deadline do
+        fiber.sleep(0.01)
+    end
+    t:is(p:stat().in_use, 0, "collected iterator returns connections")
+    count = 0
+    for _ in p:parallel_select("select * from test_parallel", {by = 'hash(id)'}) do
+        count = count + 1
+    end
+    t:is(count, 300, "pool usable afterwards")
+
+    c = p:get()
+    c:execute("drop table test_parallel")
+    p:put(c)
+    p:close()
+end
+
 local test = tap.test('oracle-connector')
-test:plan(2)
+test:plan(18)
 
 pcall(function() conn:execute('drop table test1') end)
 pcall(function() conn:execute('drop table test2') end)
-test_smoke(test, conn)
+test:test('smoke', test_smoke, conn)
+test:test('rows', test_rows, conn)
+test:test('binds', test_binds, conn)
+test:test('direct_load', test_direct_load, conn)
+test:test('execute_array', test_execute_array, conn)
+test:test('batches', test_batches, conn)
+test:test('cache', test_cache, conn)
+test:test('stat', test_stat, conn)
+test:test('slow_query', test_slow_query, conn)
+test:test('metrics', test_metrics, conn)
+test:test('prepare', test_prepare, conn)
+test:test('result_sets', test_result_sets, conn)
+test:test('autocommit', test_autocommit, conn, conn_no_raise)
+test:test('execute_batch', test_execute_batch, conn)
+test:test('export', test_export, conn)
+test:test('stream', test_stream, conn)
+test:test('export_space', test_export_space)
+test:test('parallel_select', test_parallel_select)
 pcall(function() conn:execute('drop table test1') end)
 pcall(function() conn:execute('drop table test2') end)
 